@@ -1,7 +1,10 @@
 struct buf;
 struct context;
+struct fdtable;
 struct file;
 struct inode;
+struct kmem_cache;
+struct kmemstat;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -33,6 +36,13 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+struct fdtable* fdtalloc(void);
+struct fdtable* fdtcopy(struct fdtable*);
+struct fdtable* fdtshare(struct fdtable*);
+void            fdtput(struct fdtable*);
+int             fdalloc(struct fdtable*, struct file*);
+struct file*    fdget(struct fdtable*, int);
+struct file*    fdremove(struct fdtable*, int);
 
 // fs.c
 void            fsinit(int);
@@ -63,6 +73,18 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kmemstat(struct kmemstat*);
+void*           kzalloc(void);
+int             kzerofill(void);
+void            kdup(void *);
+int             krefs(void *);
+
+// slab.c
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -70,7 +92,13 @@ void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// futex.c
+void            futexinit(void);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
+
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -86,9 +114,11 @@ int             cpuid(void);
 void            exit(int);
 int             fork(void);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+void            proc_setpagetable(struct proc*, pagetable_t, uint64, uint64);
+int             clone(uint64, uint64, uint64);
+int             join(int, uint64);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
@@ -99,11 +129,32 @@ void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
+int             waitx(uint64, uint64, uint64, uint64);
 void            wakeup(void*);
+void            wakeproc(struct proc*, void*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+void            tlbshootdown(pagetable_t);
+
+// sched.c
+void            runqinit(void);
+void            runqadd(struct proc*);
+struct proc*    runqpop(struct cpu*);
+struct proc*    runqsteal(struct cpu*);
+void            runqupdate(struct proc*);
+int             runqtick(struct proc*);
+void            runqidle(struct cpu*);
+uint64          runqvtime(void);
+void            runqsetclass(struct proc*, int);
+void            runqsetaffinity(struct proc*, uint64);
+extern int      policy;
+int             setpolicy(int);
+char*           policyname(void);
+int             edfadmit(struct proc*, int, int);
+void            edfleave(struct proc*);
+void            edfthrottle(struct proc*);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -113,6 +164,7 @@ void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
+int             tryacquire(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
@@ -145,6 +197,14 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            timerset(void);
+void            timeroff(void);
+void            cpukick(struct cpu*);
+
+// timer.c
+void            timersinit(void);
+int             timerwait(uint64);
+void            timerexpire(uint64, uint64);
 
 // uart.c
 void            uartinit(void);
@@ -162,7 +222,11 @@ pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
-int             uvmcopy(pagetable_t, pagetable_t, uint64);
+void            uvmrevoke(pagetable_t, uint64, uint64);
+int             uvmcopy(pagetable_t, pagetable_t, uint64, int);
+int             uvmcow(pagetable_t, uint64);
+int             uvmunshare(pagetable_t, uint64);
+int             uvmprivate(pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -12,17 +12,25 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
+// open files come from a kmem cache, so there is
+// no limit on them but memory. ftable.lock guards
+// their ref counts.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kmem_cache cache;
 } ftable;
 
+struct kmem_cache fdtcache;
+
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  kmem_cache_init(&ftable.cache, "file", sizeof(struct file));
+  kmem_cache_init(&fdtcache, "fdtable", sizeof(struct fdtable));
 }
 
 // Allocate a file structure.
@@ -31,16 +39,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kmem_cache_alloc(&ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -72,6 +75,7 @@ fileclose(struct file *f)
   f->ref = 0;
   f->type = FD_NONE;
   release(&ftable.lock);
+  kmem_cache_free(&ftable.cache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -180,3 +184,113 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Allocate an empty descriptor table, or return 0.
+struct fdtable*
+fdtalloc(void)
+{
+  struct fdtable *t;
+
+  if((t = kmem_cache_alloc(&fdtcache)) == 0)
+    return 0;
+  memset(t, 0, sizeof(*t));
+  initlock(&t->lock, "fdtable");
+  t->ref = 1;
+  return t;
+}
+
+// A new table with the same open files as t, for fork().
+struct fdtable*
+fdtcopy(struct fdtable *t)
+{
+  struct fdtable *nt;
+  int fd;
+
+  if((nt = fdtalloc()) == 0)
+    return 0;
+  acquire(&t->lock);
+  for(fd = 0; fd < NOFILE; fd++)
+    if(t->ofile[fd])
+      nt->ofile[fd] = filedup(t->ofile[fd]);
+  release(&t->lock);
+  return nt;
+}
+
+// Another reference to t, for a thread made by clone().
+struct fdtable*
+fdtshare(struct fdtable *t)
+{
+  acquire(&t->lock);
+  t->ref++;
+  release(&t->lock);
+  return t;
+}
+
+// Drop a reference to t. The last one closes its files.
+void
+fdtput(struct fdtable *t)
+{
+  int fd;
+
+  acquire(&t->lock);
+  if(--t->ref > 0){
+    release(&t->lock);
+    return;
+  }
+  release(&t->lock);
+  for(fd = 0; fd < NOFILE; fd++)
+    if(t->ofile[fd])
+      fileclose(t->ofile[fd]);
+  kmem_cache_free(&fdtcache, t);
+}
+
+// Allocate a file descriptor in t for f.
+// Takes over file reference from caller on success.
+int
+fdalloc(struct fdtable *t, struct file *f)
+{
+  int fd;
+
+  acquire(&t->lock);
+  for(fd = 0; fd < NOFILE; fd++){
+    if(t->ofile[fd] == 0){
+      t->ofile[fd] = f;
+      release(&t->lock);
+      return fd;
+    }
+  }
+  release(&t->lock);
+  return -1;
+}
+
+// The file open as fd in t, or 0. The caller gets a
+// reference of its own, so that another thread closing
+// fd meanwhile can't free it, and must fileclose() it.
+struct file*
+fdget(struct fdtable *t, int fd)
+{
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&t->lock);
+  if((f = t->ofile[fd]) != 0)
+    filedup(f);
+  release(&t->lock);
+  return f;
+}
+
+// Take fd out of t and return its file, whose reference
+// passes to the caller, or 0 if fd was not open.
+struct file*
+fdremove(struct fdtable *t, int fd)
+{
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&t->lock);
+  f = t->ofile[fd];
+  t->ofile[fd] = 0;
+  release(&t->lock);
+  return f;
+}
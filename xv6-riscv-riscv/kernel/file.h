@@ -9,6 +9,14 @@ struct file {
   short major;       // FD_DEVICE
 };
 
+// A process's file descriptors. Threads made by clone()
+// share their creator's table; fork() copies it.
+struct fdtable {
+  struct spinlock lock;  // protects everything below here
+  int ref;               // processes using this table
+  struct file *ofile[NOFILE];
+};
+
 #define major(dev)  ((dev) >> 16 & 0xFFFF)
 #define minor(dev)  ((dev) & 0xFFFF)
 #define	mkdev(m,n)  ((uint)((m)<<16| (n)))
@@ -18,6 +26,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // itable list
+  struct inode *prev;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -127,12 +128,12 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a table entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in table: the inode table has an entry,
+//   from a kmem cache, for each inode with in-memory
+//   pointers to it (open files and current directories),
+//   and ip->ref counts them. iget() finds or creates a
+//   table entry and increments its ref; iput() decrements
+//   ref, and frees the entry when it falls to zero.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   table entry is only correct when ip->valid is 1.
@@ -163,9 +164,10 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// entries and the list of them. Since ip->ref indicates whether
+// an entry can be freed, and ip->dev and ip->inum indicate which
+// i-node an entry holds, one must hold itable.lock while using
+// any of those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -173,18 +175,15 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;      // entries in use
+  struct kmem_cache cache;
 } itable;
 
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  kmem_cache_init(&itable.cache, "inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -242,31 +241,32 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = itable.head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Make a new inode entry.
+  if((ip = kmem_cache_alloc(&itable.cache)) == 0)
     panic("iget: no inodes");
-
-  ip = empty;
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->prev = 0;
+  ip->next = itable.head;
+  if(itable.head)
+    itable.head->prev = ip;
+  itable.head = ip;
   release(&itable.lock);
 
   return ip;
@@ -323,8 +323,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode table entry can
-// be recycled.
+// If that was the last reference, the inode table entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -353,7 +353,15 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref == 0){
+    if(ip->prev)
+      ip->prev->next = ip->next;
+    else
+      itable.head = ip->next;
+    if(ip->next)
+      ip->next->prev = ip->prev;
+    kmem_cache_free(&itable.cache, ip);
+  }
   release(&itable.lock);
 }
 
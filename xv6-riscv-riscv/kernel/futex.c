@@ -0,0 +1,128 @@
+// Futexes: user threads block on a word in memory and are
+// woken by another thread that changed it, so user-level
+// locks need not spin.
+//
+// A futex is named by the physical address of its word, so
+// every thread sharing the page sees the same one. Waiters
+// sit on a list in one of NFUTEX hashed buckets, so a wake
+// only looks at the waiters that hash alike instead of
+// every process.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct futexq {
+  struct spinlock lock;
+  struct proc *head;  // waiters, linked through p->fnext
+};
+
+struct futexq futexq[NFUTEX];
+
+void
+futexinit(void)
+{
+  struct futexq *q;
+
+  for(q = futexq; q < &futexq[NFUTEX]; q++)
+    initlock(&q->lock, "futex");
+}
+
+// Physical address of the int at user address uaddr,
+// or 0 if it isn't mapped or aligned. A copy-on-write page
+// would move when first written, so it is copied first.
+static uint64
+futexkey(uint64 uaddr)
+{
+  uint64 pa;
+
+  if(uaddr % sizeof(int) != 0)
+    return 0;
+  if(uvmunshare(myproc()->pagetable, PGROUNDDOWN(uaddr)) < 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(uaddr))) == 0)
+    return 0;
+  return pa + (uaddr - PGROUNDDOWN(uaddr));
+}
+
+static struct futexq*
+futexhash(uint64 key)
+{
+  return &futexq[(key / sizeof(int)) % NFUTEX];
+}
+
+// If the int at uaddr still holds val, sleep until
+// futexwake() on it. Returns 0 when woken, or -1 if the
+// value differed, uaddr is bad, or we were killed.
+int
+futexwait(uint64 uaddr, int val)
+{
+  struct proc *p = myproc();
+  struct proc **pp;
+  struct futexq *q;
+  uint64 key;
+  int cur;
+
+  if((key = futexkey(uaddr)) == 0)
+    return -1;
+  q = futexhash(key);
+
+  // the check and the enqueue are atomic with respect to
+  // futexwake(), which takes the same lock.
+  acquire(&q->lock);
+  if(copyin(p->pagetable, (char*)&cur, uaddr, sizeof(cur)) < 0 || cur != val){
+    release(&q->lock);
+    return -1;
+  }
+  p->futex = key;
+  p->fnext = q->head;
+  q->head = p;
+  while(p->futex != 0 && !p->killed)
+    sleep(&p->futex, &q->lock);
+
+  if(p->futex != 0){
+    // killed before anyone woke us.
+    for(pp = &q->head; *pp != p; pp = &(*pp)->fnext)
+      ;
+    *pp = p->fnext;
+    p->futex = 0;
+    release(&q->lock);
+    return -1;
+  }
+  release(&q->lock);
+  return 0;
+}
+
+// Wake up to n threads waiting on the int at uaddr.
+// Returns the number woken, or -1 if uaddr is bad.
+int
+futexwake(uint64 uaddr, int n)
+{
+  struct proc *p, **pp;
+  struct futexq *q;
+  uint64 key;
+  int woken;
+
+  if((key = futexkey(uaddr)) == 0)
+    return -1;
+  q = futexhash(key);
+
+  woken = 0;
+  acquire(&q->lock);
+  for(pp = &q->head; (p = *pp) != 0 && woken < n; ){
+    if(p->futex != key){
+      pp = &p->fnext;
+      continue;
+    }
+    *pp = p->fnext;
+    p->futex = 0;
+    wakeproc(p, &p->futex);
+    woken++;
+  }
+  release(&q->lock);
+  return woken;
+}
@@ -1,33 +1,94 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or physically contiguous blocks of 2^order pages.
 
 #include "types.h"
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "kmemstat.h"
 #include "defs.h"
 
 void freerange(void *pa_start, void *pa_end);
+static void kordercheck(void);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+// pages from KERNBASE to PHYSTOP, more than there are
+// from end to PHYSTOP.
+#define MAXPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+
+// JUNK, set by the Makefile, fills pages with junk as they are
+// freed and allocated, to catch dangling references. Build
+// with make JUNK=0 to skip the two passes over every page.
+#ifndef JUNK
+#define JUNK 1
+#endif
+
 struct run {
   struct run *next;
+  struct run *prev;  // only on the buddy lists
 };
 
-struct {
+// Each cpu allocates from and frees to its own list, and only
+// goes to the global pool in batches of KBATCH pages: to refill
+// when its list is empty, and to drain when it holds more than
+// 2*KBATCH. A cpu that finds the pool empty too steals half of
+// another cpu's list. The locks on the cpu lists are only
+// contended by stealers, and no one holds two of them at once.
+// A cpu list's lock is acquired before kmem.lock.
+// Each cpu also keeps the pages it zeroed ahead of time, while
+// idle, for its own kzalloc()s.
+struct kcache {
   struct spinlock lock;
   struct run *freelist;
+  int n;
+  struct run *zero;   // zeroed pages
+  int nzero;
+};
+
+// The global pool is a binary buddy allocator over the pages
+// from KERNBASE up to PHYSTOP. A free block of 2^k pages starts
+// at a page number (counted from KERNBASE, so the block is
+// physically aligned to its size) that is a multiple of 2^k,
+// and its buddy is the block whose page number differs only
+// in bit k. The kernel's own pages, below end, are never
+// free, so nothing merges with them. Freeing a block whose
+// buddy is free as well merges the two, so that order-0
+// pages trickling back from the cpu lists rebuild large
+// blocks.
+struct {
+  struct spinlock lock;
+  char *base;                // page 0 of the pool, KERNBASE
+  int npage;                 // number of pages from base
+  struct run *free[NORDER];  // free blocks of each order, doubly linked
+  int nfree[NORDER];
+  uchar tag[MAXPAGE];        // order+1 for the first page of a free block, else 0
+  struct kcache cpu[NCPU];
 } kmem;
 
+// How many page tables map each page that kalloc() handed
+// out, once fork() shares pages copy-on-write; kfree() only
+// frees a page when its count falls to zero. Updated with
+// atomic instructions rather than under a lock.
+int kref[MAXPAGE];
+#define KREF(pa) kref[((uint64)(pa) - KERNBASE) / PGSIZE]
+
 void
 kinit()
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.cpu[i].lock, "kcache");
+  kmem.base = (char*)KERNBASE;
+  kmem.npage = MAXPAGE;
   freerange(end, (void*)PHYSTOP);
+  kordercheck();
 }
 
 void
@@ -35,8 +96,158 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    KREF(p) = 1;
     kfree(p);
+  }
+}
+
+static struct run*
+pageaddr(int i)
+{
+  return (struct run*)(kmem.base + (uint64)i * PGSIZE);
+}
+
+static int
+pageno(void *pa)
+{
+  return ((char*)pa - kmem.base) / PGSIZE;
+}
+
+static void
+buddylink(int i, int k)
+{
+  struct run *r = pageaddr(i);
+
+  r->prev = 0;
+  r->next = kmem.free[k];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[k] = r;
+  kmem.nfree[k]++;
+  kmem.tag[i] = k + 1;
+}
+
+static void
+buddyunlink(int i, int k)
+{
+  struct run *r = pageaddr(i);
+
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[k]--;
+  kmem.tag[i] = 0;
+}
+
+// Put the block of 2^k pages at pa in the pool, merging it
+// with its buddy for as long as that is free.
+// kmem.lock must be held.
+static void
+buddyfree(void *pa, int k)
+{
+  int i, b;
+
+  i = pageno(pa);
+  while(k < MAXORDER){
+    b = i ^ (1 << k);
+    if(b + (1 << k) > kmem.npage || kmem.tag[b] != k + 1)
+      break;
+    buddyunlink(b, k);
+    i &= ~(1 << k);
+    k++;
+  }
+  buddylink(i, k);
+}
+
+// Take a block of 2^k pages from the pool, splitting a
+// larger one if need be. kmem.lock must be held.
+static void*
+buddyalloc(int k)
+{
+  int i, j;
+
+  for(j = k; j < NORDER && kmem.free[j] == 0; j++)
+    ;
+  if(j == NORDER)
+    return 0;
+  i = pageno(kmem.free[j]);
+  buddyunlink(i, j);
+  while(j > k){
+    j--;
+    buddylink(i + (1 << j), j);
+  }
+  return pageaddr(i);
+}
+
+// Take half of some other cpu's pages, keep all but one in
+// c, and return that one, or 0 if every cpu is empty too.
+// Called without c->lock held.
+static struct run*
+ksteal(struct kcache *c)
+{
+  struct kcache *v;
+  struct run *r, *got;
+  int n;
+
+  got = 0;
+  n = 0;
+  for(v = kmem.cpu; v < &kmem.cpu[NCPU] && n == 0; v++){
+    if(v == c)
+      continue;
+    acquire(&v->lock);
+    while(n < (v->n + 1) / 2){
+      r = v->freelist;
+      v->freelist = r->next;
+      r->next = got;
+      got = r;
+      n++;
+    }
+    v->n -= n;
+    release(&v->lock);
+  }
+  if(n == 0)
+    return 0;
+
+  r = got;
+  acquire(&c->lock);
+  while((got = r->next) != 0){
+    r->next = got->next;
+    got->next = c->freelist;
+    c->freelist = got;
+    c->n++;
+  }
+  release(&c->lock);
+  return r;
+}
+
+// Give every page on the cpu lists back to the pool, so that
+// they can merge into larger blocks.
+static void
+kdrain(void)
+{
+  struct kcache *c;
+  struct run *r;
+
+  for(c = kmem.cpu; c < &kmem.cpu[NCPU]; c++){
+    acquire(&c->lock);
+    acquire(&kmem.lock);
+    while((r = c->freelist) != 0){
+      c->freelist = r->next;
+      buddyfree(r, 0);
+    }
+    c->n = 0;
+    while((r = c->zero) != 0){
+      c->zero = r->next;
+      buddyfree(r, 0);
+    }
+    c->nzero = 0;
+    release(&kmem.lock);
+    release(&c->lock);
+  }
 }
 
 // Free the page of physical memory pointed at by v,
@@ -47,19 +258,95 @@ void
 kfree(void *pa)
 {
   struct run *r;
+  struct kcache *c;
+  int i;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  // still mapped copy-on-write somewhere else?
+  if((i = __sync_sub_and_fetch(&KREF(pa), 1)) > 0)
+    return;
+  if(i < 0)
+    panic("kfree: ref");
+
+#if JUNK
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  c = &kmem.cpu[cpuid()];
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  c->n++;
+  if(c->n > 2*KBATCH){
+    acquire(&kmem.lock);
+    for(i = 0; i < KBATCH; i++){
+      r = c->freelist;
+      c->freelist = r->next;
+      buddyfree(r, 0);
+    }
+    c->n -= KBATCH;
+    release(&kmem.lock);
+  }
+  release(&c->lock);
+  pop_off();
+}
+
+// Take a page from this cpu's list, the pool, or another
+// cpu, in that order.
+static struct run*
+kpage(void)
+{
+  struct run *r;
+  struct kcache *c;
+  int i;
+
+  push_off();
+  c = &kmem.cpu[cpuid()];
+  acquire(&c->lock);
+  if(c->freelist == 0){
+    acquire(&kmem.lock);
+    for(i = 0; i < KBATCH && (r = buddyalloc(0)) != 0; i++){
+      r->next = c->freelist;
+      c->freelist = r;
+      c->n++;
+    }
+    release(&kmem.lock);
+  }
+  r = c->freelist;
+  if(r){
+    c->freelist = r->next;
+    c->n--;
+  }
+  release(&c->lock);
+  if(r == 0)
+    r = ksteal(c);
+  pop_off();
+  return r;
+}
+
+// Take a page from those c zeroed ahead, if any. The count
+// is read first without the lock, so that an empty pool
+// costs nothing.
+static struct run*
+kzpop(struct kcache *c)
+{
+  struct run *r;
+
+  if(c->nzero == 0)
+    return 0;
+  acquire(&c->lock);
+  if((r = c->zero) != 0){
+    c->zero = r->next;
+    c->nzero--;
+  }
+  release(&c->lock);
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -69,14 +356,179 @@ void *
 kalloc(void)
 {
   struct run *r;
+  struct kcache *c;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
+  // zeroed pages are free pages too, if there are no others.
+  if((r = kpage()) == 0)
+    for(c = kmem.cpu; c < &kmem.cpu[NCPU] && r == 0; c++)
+      r = kzpop(c);
   if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
-
+    KREF(r) = 1;
+#if JUNK
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
   return (void*)r;
 }
+
+// Allocate one zeroed page, from those this cpu zeroed
+// while idle if there are any.
+void *
+kzalloc(void)
+{
+  struct run *r;
+
+  push_off();
+  r = kzpop(&kmem.cpu[cpuid()]);
+  pop_off();
+  if(r != 0){
+    r->next = 0;
+    KREF(r) = 1;
+    return (void*)r;
+  }
+
+  if((r = kpage()) != 0){
+    memset((char*)r, 0, PGSIZE);
+    KREF(r) = 1;
+  }
+  return (void*)r;
+}
+
+// Note another page table mapping the page at pa.
+void
+kdup(void *pa)
+{
+  __sync_fetch_and_add(&KREF(pa), 1);
+}
+
+// How many page tables map the page at pa.
+int
+krefs(void *pa)
+{
+  return __atomic_load_n(&KREF(pa), __ATOMIC_SEQ_CST);
+}
+
+// Called by an idle cpu: zero a page for its kzalloc()s,
+// unless NZERO are ready already. Returns 1 if it did.
+int
+kzerofill(void)
+{
+  struct kcache *c;
+  struct run *r;
+
+  push_off();
+  c = &kmem.cpu[cpuid()];
+  if(c->nzero >= NZERO || (r = kpage()) == 0){
+    pop_off();
+    return 0;
+  }
+  memset((char*)r, 0, PGSIZE);
+  acquire(&c->lock);
+  r->next = c->zero;
+  c->zero = r;
+  c->nzero++;
+  release(&c->lock);
+  pop_off();
+  return 1;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Returns 0 if there is no such block.
+void *
+kalloc_order(int order)
+{
+  void *pa;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
+  acquire(&kmem.lock);
+  pa = buddyalloc(order);
+  release(&kmem.lock);
+  if(pa == 0){
+    // pages idle on the cpu lists may complete a block.
+    kdrain();
+    acquire(&kmem.lock);
+    pa = buddyalloc(order);
+    release(&kmem.lock);
+  }
+
+#if JUNK
+  if(pa)
+    memset(pa, 5, PGSIZE << order); // fill with junk
+#endif
+  return pa;
+}
+
+// Free a block returned by kalloc_order(order).
+void
+kfree_order(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order > MAXORDER ||
+     ((char*)pa - kmem.base) % (PGSIZE << order) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+#if JUNK
+  memset(pa, 1, PGSIZE << order);
+#endif
+
+  acquire(&kmem.lock);
+  buddyfree(pa, order);
+  release(&kmem.lock);
+}
+
+// Called once at boot, before anyone else allocates:
+// check that kalloc_order() blocks of every order are
+// aligned to their size, and that freeing them merges
+// the pool back to what it was.
+static void
+kordercheck(void)
+{
+  struct kmemstat before, after;
+  void *pa;
+  int k;
+
+  kmemstat(&before);
+  for(k = 0; k <= MAXORDER; k++){
+    if((pa = kalloc_order(k)) == 0)
+      panic("kordercheck: alloc");
+    if((uint64)pa % (PGSIZE << k) != 0)
+      panic("kordercheck: align");
+    kfree_order(pa, k);
+  }
+  kmemstat(&after);
+  for(k = 0; k <= MAXORDER; k++)
+    if(after.nfree[k] != before.nfree[k])
+      panic("kordercheck: merge");
+  if(after.cached != before.cached)
+    panic("kordercheck: cached");
+}
+
+// Fill in st with the free blocks of each order, the pages
+// on the cpu lists, and the zeroed pages, for diagnostics.
+void
+kmemstat(struct kmemstat *st)
+{
+  struct kcache *c;
+  int k;
+
+  acquire(&kmem.lock);
+  for(k = 0; k < NORDER; k++)
+    st->nfree[k] = kmem.nfree[k];
+  release(&kmem.lock);
+  st->zeroed = 0;
+  st->cached = 0;
+  for(c = kmem.cpu; c < &kmem.cpu[NCPU]; c++){
+    acquire(&c->lock);
+    st->cached += c->n;
+    st->zeroed += c->nzero;
+    release(&c->lock);
+  }
+}
@@ -0,0 +1,6 @@
+// Free physical memory, for kmemstat().
+struct kmemstat {
+  uint64 nfree[NORDER];  // free blocks of 2^k pages in the buddy pool
+  uint64 cached;         // free pages on the per-cpu lists
+  uint64 zeroed;         // pages zeroed ahead for kzalloc()
+};
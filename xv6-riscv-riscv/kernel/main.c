@@ -20,6 +20,8 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
+    futexinit();     // futex wait queues
+    timersinit();    // sleep timers
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
@@ -27,6 +29,7 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pipeinit();      // pipe cache
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -1,8 +1,7 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC       512  // maximum number of processes; allocated as needed
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // active i-nodes usertests' iref expects to fit; the table grows as needed
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
@@ -11,3 +10,17 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define NQUEUE        5  // MLFQ priority queues
+#define NCLASS        5  // scheduling classes, see sched.h
+#define BATCHSLICE   10  // ticks a batch process runs before yielding to batch peers
+#define NTICKETS    100  // default stride tickets per process
+#define STRIDE1  (1<<20) // stride of a process with one ticket
+#define TICKCYCLES 1000000 // timer cycles per tick; about 1/10th second in qemu
+#define NFUTEX       64  // futex wait queue buckets
+#define MAXORDER     10  // largest kalloc_order() block is 2^MAXORDER pages
+#define NORDER      (MAXORDER+1)  // kalloc_order() orders, 0 to MAXORDER
+#define KBATCH       32  // pages a cpu moves to or from the global free pool at once
+#define NZERO        16  // pages each idle cpu keeps zeroed for kzalloc()
+#define NMAG         16  // free objects a cpu keeps per kmem cache
+#define NSLEEPQ      61  // sleep queue buckets; prime, to spread aligned chans
+#define EDFUTIL     900  // bound on total EDF utilisation, in thousandths of a cpu
@@ -4,25 +4,49 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "rusage.h"
+#include "slab.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// struct procs come from proccache as they are needed,
+// and are never freed; allproc lists every one there is, in
+// slot order. Entries are only ever appended, so the list
+// can be walked without a lock.
+struct kmem_cache proccache;
+struct proc *allproc;
+static struct proc **allproctail = &allproc;
+int nproc;      // slots made so far, at most NPROC
+uint kstackgen; // bumped whenever a kernel stack is mapped
+
+extern pagetable_t kernel_pagetable;
 
 struct proc *initproc;
 
 int nextpid = 1;
+
+// UNUSED procs, as a stack, and the others chained by
+// pid % NPROC; pids are handed out in order, so live ones
+// spread evenly. pid_lock guards these, nextpid, and the
+// growth of allproc and the kernel stacks, and is acquired
+// after any p->lock.
+struct proc *freeprocs[NPROC];
+int nfree;
+struct proc *pidhash[NPROC];
 struct spinlock pid_lock;
 
 //SN-variables
-int lastproc = -1, sncount = 0, WTIME = 500;
-int LEN[5] = {0, 0, 0, 0, 0}; //length of each queue
-
-int slice[5] = {1, 2, 4, 8, 16}; //quantum for each queue
+int lastproc = -1;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void setrunnable(struct proc *p);
+static void account(struct proc *p);
+static int pending(struct proc *p);
+int maxi(int a, int b);
+int mini(int a, int b);
 
 extern char trampoline[]; // trampoline.S
 
@@ -32,35 +56,106 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void proc_mapstacks(pagetable_t kpgtbl)
+// guards the sharing of user page tables by threads:
+// which procs use a page table, and their sz.
+// a proc's thread_lock is acquired after its p->lock.
+struct spinlock thread_lock;
+
+// processes in sleep(), hashed by chan, so that wakeup()
+// only looks at the processes sleeping on its chan.
+// a bucket's lock is acquired before any p->lock.
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
+} sleepq[NSLEEPQ];
+
+static struct sleepq *sleepqof(void *chan)
+{
+  return &sleepq[((uint64)chan >> 3) % NSLEEPQ];
+}
+
+// initialize the proc table at boot time.
+void procinit(void)
+{
+  initlock(&pid_lock, "nextpid");
+  initlock(&wait_lock, "wait_lock");
+  initlock(&thread_lock, "thread");
+  for (int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
+  kmem_cache_init(&proccache, "proc", sizeof(struct proc));
+  runqinit();
+}
+
+// Make a new proc slot and push it on the free stack.
+// pid_lock must be held.
+static void
+procgrow(void)
 {
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++)
+  if (nproc == NPROC || (p = kmem_cache_alloc(&proccache)) == 0)
+    return;
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+  p->idx = nproc++;
+  freeprocs[nfree++] = p;
+
+  // publish the new proc only once it is set up.
+  __sync_synchronize();
+  *allproctail = p;
+  allproctail = &p->allnext;
+}
+
+// Map a kernel stack for p at KSTACK(p->idx), between
+// invalid guard pages. pid_lock must be held, which also
+// keeps harts from changing the kernel page table at once.
+static int
+kstackmap(struct proc *p)
+{
+  char *pa;
+  uint64 va = KSTACK(p->idx);
+
+  if ((pa = kalloc()) == 0)
+    return -1;
+  if (mappages(kernel_pagetable, va, PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0)
   {
-    char *pa = kalloc();
-    if (pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int)(p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+    kfree(pa);
+    return -1;
   }
+  p->kstack = va;
+
+  // make other cpus flush their TLBs before running on it.
+  __sync_synchronize();
+  kstackgen++;
+  return 0;
 }
 
-// initialize the proc table at boot time.
-void procinit(void)
+// Make the other harts running threads that share pagetable
+// forget its old PTEs, which the caller has just changed.
+// uservec flushes the TLB on every way into the kernel, so
+// kick each such hart that is in user space and wait for it
+// to come in; a hart already in the kernel flushes again on
+// its way out. Kicked harts never wait on us, so the caller
+// may hold locks.
+void tlbshootdown(pagetable_t pagetable)
 {
-  struct proc *p;
+  struct cpu *c;
+  struct proc *q;
+  uint seq;
 
-  initlock(&pid_lock, "nextpid");
-  initlock(&wait_lock, "wait_lock");
-  for (p = proc; p < &proc[NPROC]; p++)
+  push_off();
+  __sync_synchronize();
+  for (c = cpus; c < &cpus[NCPU]; c++)
   {
-    initlock(&p->lock, "proc");
-    p->kstack = KSTACK((int)(p - proc));
+    seq = c->userseq;
+    if (c == mycpu() || (seq & 1) == 0 || (q = c->proc) == 0 ||
+        q->pagetable != pagetable)
+      continue;
+    cpukick(c);
+    while (*(volatile uint *)&c->userseq == seq)
+      ;
   }
+  pop_off();
 }
 
 // Must be called with interrupts disabled,
@@ -93,19 +188,77 @@ myproc(void)
   return p;
 }
 
-int allocpid()
+// Give p the next pid and enter it in pidhash.
+// p->lock must be held.
+int allocpid(struct proc *p)
 {
   int pid;
 
   acquire(&pid_lock);
   pid = nextpid;
   nextpid = nextpid + 1;
+  p->pid = pid;
+  p->pidnext = pidhash[pid % NPROC];
+  pidhash[pid % NPROC] = p;
   release(&pid_lock);
 
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
+// Take p out of pidhash and put its slot back on the
+// free stack. p->lock must be held.
+static void
+freepid(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for (pp = &pidhash[p->pid % NPROC]; *pp; pp = &(*pp)->pidnext)
+  {
+    if (*pp == p)
+    {
+      *pp = p->pidnext;
+      break;
+    }
+  }
+  p->pidnext = 0;
+  p->pid = 0;
+  freeprocs[nfree++] = p;
+  release(&pid_lock);
+}
+
+// Find the process with the given pid and return it
+// with p->lock held, or return 0 if there is none.
+static struct proc *
+findproc(int pid)
+{
+  struct proc *p;
+
+  if (pid <= 0)
+    return 0;
+  acquire(&pid_lock);
+  for (p = pidhash[pid % NPROC]; p; p = p->pidnext)
+  {
+    if (p->pid == pid)
+      break;
+  }
+  release(&pid_lock);
+  if (p == 0)
+    return 0;
+
+  // pid_lock comes after p->lock, so look again: p may
+  // have been freed, and even reused, in between.
+  acquire(&p->lock);
+  if (p->pid != pid || p->state == UNUSED)
+  {
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Take an UNUSED proc off the free stack, making more
+// procs, and its kernel stack, if need be.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
@@ -115,22 +268,22 @@ allocproc(void)
 {
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++)
+  acquire(&pid_lock);
+  if (nfree == 0)
+    procgrow();
+  p = nfree > 0 ? freeprocs[nfree - 1] : 0;
+  if (p && p->kstack == 0 && kstackmap(p) < 0)
+    p = 0;
+  if (p == 0)
   {
-    acquire(&p->lock);
-    if (p->state == UNUSED)
-    {
-      goto found;
-    }
-    else
-    {
-      release(&p->lock);
-    }
+    release(&pid_lock);
+    return 0;
   }
-  return 0;
+  nfree--;
+  release(&pid_lock);
+  acquire(&p->lock);
 
-found:
-  p->pid = allocpid();
+  allocpid(p);
   p->state = USED;
 
   p->c_time = ticks; // When was the process created
@@ -141,37 +294,36 @@ found:
   p->r_time = 0;    // how long the process is running
   p->e_time = 0;    // When was the process exited
   p->n_run = 0;     // number of times a process is picked by a  cpu
-  p->w_time = 0;
+  p->stamp = ticks;
+  p->mstamp = *(uint64 *)CLINT_MTIME;
+  p->timeridx = -1;
+  p->runcycles = p->waitcycles = p->sleepcycles = p->nswitch = 0;
+  p->cruncycles = p->cwaitcycles = p->csleepcycles = p->cnswitch = 0;
 
-  for (int i = 0; i < 5; i++)
+  for (int i = 0; i < NQUEUE; i++)
   {
     p->ticks[i] = 0;
     p->total_ticks[i] = 0;
   }
 
-#ifdef FCFS
-  p->SP = -1;
-  p->DP = -1;
-  p->niceness = -1;
-#endif
-
-#ifdef RR
-  p->SP = -1;
-  p->DP = -1;
-  p->niceness = -1;
-#endif
-
-#ifdef PBS
+  // The policy can change at run time (setsched),
+  // so set up every policy's state.
   p->SP = 60;
   p->niceness = 5;
   p->DP = 60;
   if (p->pid <= 2)
     p->DP = 1;
-#endif
-
-#ifdef MLFQ
   p->q_num = 0;
-#endif
+  p->cls = CLASS_NORMAL;
+  p->runticks = 0;
+  p->tickets = NTICKETS;
+  p->affinity = ~0UL;
+  p->tfva = TRAPFRAME;
+  p->thread = 0;
+  p->lastcpu = -1;
+  p->migrations = 0;
+  p->pass = 0;
+  p->fdt = 0;
 
   // Allocate a trapframe page.
   if ((p->trapframe = (struct trapframe *)kalloc()) == 0)
@@ -208,11 +360,8 @@ freeproc(struct proc *p)
   if (p->trapframe)
     kfree((void *)p->trapframe);
   p->trapframe = 0;
-  if (p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
-  p->pagetable = 0;
-  p->sz = 0;
-  p->pid = 0;
+  proc_setpagetable(p, 0, 0, 0);
+  freepid(p);
   p->parent = 0;
   p->name[0] = 0;
   p->chan = 0;
@@ -265,6 +414,37 @@ void proc_freepagetable(pagetable_t pagetable, uint64 sz)
   uvmfree(pagetable, sz);
 }
 
+// Switch p to user page table pagetable (or none), of sz
+// bytes and mapping p's trapframe at tfva, and give up the
+// old one: free it and its memory, unless threads still
+// share it, in which case only unmap p's trapframe.
+void proc_setpagetable(struct proc *p, pagetable_t pagetable, uint64 sz, uint64 tfva)
+{
+  pagetable_t old = p->pagetable;
+  uint64 oldsz = p->sz;
+  uint64 oldtfva = p->tfva;
+  struct proc *q;
+  int shared = 0;
+
+  acquire(&thread_lock);
+  p->pagetable = pagetable;
+  p->sz = sz;
+  p->tfva = tfva;
+  for (q = allproc; q; q = q->allnext)
+    if (old != 0 && q->pagetable == old)
+      shared = 1;
+  if (shared)
+    uvmunmap(old, oldtfva, 1, 0);
+  release(&thread_lock);
+
+  if (old != 0 && !shared)
+  {
+    uvmunmap(old, oldtfva, 1, 0);
+    uvmunmap(old, TRAMPOLINE, 1, 0);
+    uvmfree(old, oldsz);
+  }
+}
+
 // a user program that calls exec("/init")
 // od -t xC initcode
 uchar initcode[] = {
@@ -283,6 +463,9 @@ void userinit(void)
 
   p = allocproc();
   initproc = p;
+  p->sysproc = 1;
+  if ((p->fdt = fdtalloc()) == 0)
+    panic("userinit: fdtalloc");
 
   // allocate one user page and copy init's instructions
   // and data into it.
@@ -296,33 +479,42 @@ void userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
-  p->s_time = ticks;
-  p->w_time = 0;
+  setrunnable(p);
 
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
+// Threads sharing the page table see the new size too.
 int growproc(int n)
 {
   uint sz;
   struct proc *p = myproc();
+  struct proc *q;
 
+  acquire(&thread_lock);
   sz = p->sz;
   if (n > 0)
   {
     if ((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0)
     {
+      release(&thread_lock);
       return -1;
     }
   }
   else if (n < 0)
   {
+    // other threads' harts may still reach the pages
+    // through their TLBs: cut them off before freeing.
+    uvmrevoke(p->pagetable, sz, sz + n);
+    tlbshootdown(p->pagetable);
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  for (q = allproc; q; q = q->allnext)
+    if (q->pagetable == p->pagetable)
+      q->sz = sz;
+  release(&thread_lock);
   return 0;
 }
 
@@ -331,8 +523,8 @@ int growproc(int n)
 //SNXX:again has to update stime here
 int fork(void)
 {
-  int i, pid;
-  struct proc *np;
+  int pid, shared;
+  struct proc *np, *q;
   struct proc *p = myproc();
 
   // Allocate process.
@@ -341,8 +533,16 @@ int fork(void)
     return -1;
   }
 
-  // Copy user memory from parent to child.
-  if (uvmcopy(p->pagetable, np->pagetable, p->sz) < 0)
+  // Share user memory with the child copy-on-write, unless
+  // other threads use p's page table: they could go on
+  // writing pages through stale TLB entries, so copy it all.
+  shared = 0;
+  acquire(&thread_lock);
+  for (q = allproc; q; q = q->allnext)
+    if (q != p && q->pagetable == p->pagetable)
+      shared = 1;
+  release(&thread_lock);
+  if (uvmcopy(p->pagetable, np->pagetable, p->sz, !shared) < 0)
   {
     freeproc(np);
     release(&np->lock);
@@ -355,13 +555,25 @@ int fork(void)
 
   np->mask = p->mask;
 
+  // init's children are the console shells.
+  np->sysproc = (p == initproc);
+
+  // an EDF reservation belongs to p alone.
+  np->cls = p->cls == CLASS_EDF ? CLASS_NORMAL : p->cls;
+  np->tickets = p->tickets;
+  np->pass = runqvtime();
+  np->affinity = p->affinity;
+
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
-  for (i = 0; i < NOFILE; i++)
-    if (p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
+  // copy the descriptor table, with a reference to each file.
+  if ((np->fdt = fdtcopy(p->fdt)) == 0)
+  {
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
   np->cwd = idup(p->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
@@ -375,22 +587,154 @@ int fork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
-  np->s_time = ticks;
-  np->w_time = 0;
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread: a process that shares the caller's page
+// table, and so its memory, and starts at user address fn
+// with arg in a0 and its stack pointer at stack. Its open
+// files are the caller's, as after fork(). fn must not
+// return; it ends with exit(), and the caller collects it
+// with join(). Returns the thread's pid, or -1.
+int clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  // p may still share pages copy-on-write since a fork();
+  // copy them before threads share the page table.
+  if (uvmprivate(p->pagetable, p->sz) < 0)
+    return -1;
+
+  // Allocate process.
+  if ((np = allocproc()) == 0)
+  {
+    return -1;
+  }
+
+  // Trade the page table allocproc() made for a mapping of
+  // np's trapframe in ours, at an address unique to np.
+  proc_setpagetable(np, 0, 0, 0);
+  acquire(&thread_lock);
+  if (mappages(p->pagetable, THREADFRAME(np->idx), PGSIZE,
+               (uint64)(np->trapframe), PTE_R | PTE_W) < 0)
+  {
+    release(&thread_lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->pagetable = p->pagetable;
+  np->sz = p->sz;
+  np->tfva = THREADFRAME(np->idx);
+  release(&thread_lock);
+  np->thread = 1;
+  np->ustack = stack;
+
+  // start at fn(arg), on the new stack.
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+
+  np->mask = p->mask;
+  np->cls = p->cls == CLASS_EDF ? CLASS_NORMAL : p->cls;
+  np->tickets = p->tickets;
+  np->pass = runqvtime();
+  np->affinity = p->affinity;
+
+  // threads share the descriptor table.
+  np->fdt = fdtshare(p->fdt);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
 
   release(&np->lock);
 
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
   return pid;
 }
 
+// Wait for thread tid, or any thread if tid is 0, created
+// by this process to exit, and return its pid. Copies the
+// stack it was given to user address stack, if not 0.
+// Return -1 if there is no such thread.
+int join(int tid, uint64 stack)
+{
+  struct proc *np;
+  int havekids, pid;
+  struct proc *p = myproc();
+
+  acquire(&wait_lock);
+
+  for (;;)
+  {
+    // Scan through table looking for exited threads.
+    havekids = 0;
+    for (np = allproc; np; np = np->allnext)
+    {
+      if (np->parent == p && np->thread && (tid == 0 || np->pid == tid))
+      {
+        // make sure the thread isn't still in exit() or swtch().
+        acquire(&np->lock);
+
+        havekids = 1;
+        if (np->state == ZOMBIE)
+        {
+          // Found one.
+          pid = np->pid;
+          if (stack != 0 && copyout(p->pagetable, stack, (char *)&np->ustack,
+                                    sizeof(np->ustack)) < 0)
+          {
+            release(&np->lock);
+            release(&wait_lock);
+            return -1;
+          }
+          p->cruncycles += np->runcycles + np->cruncycles;
+          p->cwaitcycles += np->waitcycles + np->cwaitcycles;
+          p->csleepcycles += np->sleepcycles + np->csleepcycles;
+          p->cnswitch += np->nswitch + np->cnswitch;
+          freeproc(np);
+          release(&np->lock);
+          release(&wait_lock);
+          return pid;
+        }
+        release(&np->lock);
+      }
+    }
+
+    // No point waiting if we don't have any threads.
+    if (!havekids || p->killed)
+    {
+      release(&wait_lock);
+      return -1;
+    }
+
+    // Wait for a thread to exit.
+    sleep(p, &wait_lock);
+  }
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for (pp = proc; pp < &proc[NPROC]; pp++)
+  for (pp = allproc; pp; pp = pp->allnext)
   {
     if (pp->parent == p)
     {
@@ -400,6 +744,26 @@ void reparent(struct proc *p)
   }
 }
 
+// Kill the threads sharing p's page table.
+static void killthreads(struct proc *p)
+{
+  struct proc *q;
+
+  for (q = allproc; q; q = q->allnext)
+  {
+    if (q == p)
+      continue;
+    acquire(&q->lock);
+    if (q->thread && q->pagetable == p->pagetable && q->state != UNUSED)
+    {
+      q->killed = 1;
+      if (q->state == SLEEPING)
+        setrunnable(q);
+    }
+    release(&q->lock);
+  }
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait().
@@ -411,16 +775,13 @@ void exit(int status)
   if (p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for (int fd = 0; fd < NOFILE; fd++)
-  {
-    if (p->ofile[fd])
-    {
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
-    }
-  }
+  // a process takes its threads with it.
+  if (!p->thread)
+    killthreads(p);
+
+  // Close all open files, unless other threads still use them.
+  fdtput(p->fdt);
+  p->fdt = 0;
 
   begin_op();
   iput(p->cwd);
@@ -437,6 +798,13 @@ void exit(int status)
 
   acquire(&p->lock);
 
+  if (p->cls == CLASS_EDF)
+  {
+    edfleave(p);
+    p->cls = CLASS_NORMAL;
+  }
+
+  account(p);
   p->xstate = status;
   p->state = ZOMBIE;
   p->e_time = ticks;
@@ -451,6 +819,14 @@ void exit(int status)
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int wait(uint64 addr)
+{
+  return waitx(addr, 0, 0, 0);
+}
+
+// wait(), also copying out the child's total ticks spent
+// waiting for a cpu, ticks run, and times picked by a cpu
+// to the user addresses wtime, rtime and nrun, if not 0.
+int waitx(uint64 addr, uint64 wtime, uint64 rtime, uint64 nrun)
 {
   struct proc *np;
   int havekids, pid;
@@ -462,9 +838,11 @@ int wait(uint64 addr)
   {
     // Scan through table looking for exited children.
     havekids = 0;
-    for (np = proc; np < &proc[NPROC]; np++)
+    for (np = allproc; np; np = np->allnext)
     {
-      if (np->parent == p)
+      // threads are collected by join(), or by init
+      // if they outlive their creator.
+      if (np->parent == p && (!np->thread || p == initproc))
       {
         // make sure the child isn't still in exit() or swtch().
         acquire(&np->lock);
@@ -474,14 +852,24 @@ int wait(uint64 addr)
         {
           // Found one.
           pid = np->pid;
-          np->n_run = 0;
-          if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                   sizeof(np->xstate)) < 0)
+          if ((addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                    sizeof(np->xstate)) < 0) ||
+              (wtime != 0 && copyout(p->pagetable, wtime, (char *)&np->tot_wtime,
+                                     sizeof(np->tot_wtime)) < 0) ||
+              (rtime != 0 && copyout(p->pagetable, rtime, (char *)&np->r_time,
+                                     sizeof(np->r_time)) < 0) ||
+              (nrun != 0 && copyout(p->pagetable, nrun, (char *)&np->n_run,
+                                    sizeof(np->n_run)) < 0))
           {
             release(&np->lock);
             release(&wait_lock);
             return -1;
           }
+          np->n_run = 0;
+          p->cruncycles += np->runcycles + np->cruncycles;
+          p->cwaitcycles += np->waitcycles + np->cwaitcycles;
+          p->csleepcycles += np->sleepcycles + np->csleepcycles;
+          p->cnswitch += np->nswitch + np->cnswitch;
           freeproc(np);
           release(&np->lock);
           release(&wait_lock);
@@ -506,251 +894,66 @@ int wait(uint64 addr)
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - take the next process off this CPU's run queue.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
-// SNXX: has to do a lot of shit here
+// Which process comes off the queue depends on the
+// SCHEDULER policy, see runqpeek() and the class pick hooks in sched.c.
 void scheduler(void)
 {
-
+  struct proc *p;
   struct cpu *c = mycpu();
 
   c->proc = 0;
+  c->online = 1;
   for (;;)
   {
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-#ifdef RR
-    if (sncount == 0)
+    // Nothing queued here: take work from the busiest cpu,
+    // or wait for some.
+    if ((p = runqpop(c)) == 0 && (p = runqsteal(c)) == 0)
     {
-      //printf("entred in to RR bro\n");
-      sncount++;
-    }
-
-    struct proc *p;
-
-    for (p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-      if (p->state == RUNNABLE)
-      {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-        if (lastproc != p->pid)
-        {
-          p->n_run++;
-          lastproc = p->pid;
-        }
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
-#endif
-
-#ifdef FCFS
-    if (sncount == 0)
-    {
-      //printf("entred in to FCFS bro");
-      sncount++;
+      runqidle(c);
+      continue;
     }
-    struct proc *min, *pi, *pj;
 
-    for (pi = proc; pi < &proc[NPROC]; pi++)
+    acquire(&p->lock);
+    if (p->state == RUNNABLE)
     {
-      acquire(&pi->lock);
-      if (pi->state == RUNNABLE)
+      if (lastproc != p->pid)
       {
-        min = pi;
-        for (pj = proc; pj < &proc[NPROC]; pj++)
-        {
-
-          if (pj->state == RUNNABLE && pj->pid > 2)
-          {
-            if (min->c_time > pj->c_time)
-              min = pj;
-          }
-        }
-        if (lastproc != min->pid)
-        {
-          min->n_run++;
-          lastproc = min->pid;
-        }
-
-        min->state = RUNNING;
-        c->proc = min;
-        swtch(&c->context, &min->context);
-        c->proc = 0;
+        p->n_run++;
+        lastproc = p->pid;
       }
-      release(&pi->lock);
-    }
-#endif
-
-#ifdef PBS
-
-    struct proc *min, *pi, *pj;
-
-    for (pi = proc; pi < &proc[NPROC]; pi++)
-    {
-      acquire(&pi->lock);
-      if (pi->state == RUNNABLE)
+      account(p);
+      p->runticks = 0;
+      p->nswitch++;
+      if (p->lastcpu >= 0 && p->lastcpu != c - cpus)
+        p->migrations++;
+      p->lastcpu = c - cpus;
+
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      // p's kernel stack may be newer than this cpu's TLB.
+      if (c->kstackgen != kstackgen)
       {
-        min = pi;
-        for (pj = proc; pj < &proc[NPROC]; pj++)
-        {
-
-          if (pj->state == RUNNABLE)
-          {
-            if (min->DP > pj->DP)
-              min = pj;
-
-            else if (min->DP == pj->DP)
-            {
-              if (min->n_run > pj->n_run)
-                min = pj;
-              else if (min->n_run == pj->n_run)
-              {
-                if (min->c_time > pj->c_time)
-                  min = pj;
-              }
-            }
-          }
-        }
-
-        if (lastproc != min->pid)
-        {
-          min->n_run++;
-          lastproc = min->pid;
-        }
-
-        min->state = RUNNING;
-        c->proc = min;
-        swtch(&c->context, &min->context);
-        c->proc = 0;
+        c->kstackgen = kstackgen;
+        sfence_vma();
       }
-      release(&pi->lock);
-    }
 
-#endif
+      p->state = RUNNING;
+      c->proc = p;
+      swtch(&c->context, &p->context);
 
-#ifdef MLFQ
-    
-    struct proc *p;
-    for (p = proc; p < &proc[NPROC]; p++) //demoter
-    {
-      acquire(&p->lock);
-      if (p->state == RUNNABLE)
-      {
-        if (p->ticks[p->q_num] >= slice[p->q_num]) // I will demote you Bitch
-        {
-          //updating properties of process.......
-          p->w_time = 0;
-          p->ticks[p->q_num] = 0; // ticks spent by the process in the demoted queue
-          if (p->q_num + 1 <= 4)
-            p->q_num++;
-          p->s_time = ticks; //s_time or the time at which the process becomes runnable in demoted queue
-          //updated properties of process.........
-        }
-      }
-      release(&p->lock);
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
     }
-
-    for (p = proc; p < &proc[NPROC]; p++) //promoter
-    {
-      acquire(&p->lock);
-      if (p->state == RUNNABLE)
-      {
-        if ((ticks - p->s_time) > WTIME) // promote me you bitchy scheduler
-        {
-          //updating properties of process.......
-          p->w_time = 0;
-          p->ticks[p->q_num] = 0; // ticks spent by the process in the demoted queue
-          if (p->q_num - 1 >= 0)
-            p->q_num--;
-          p->s_time = ticks; //s_time or the time at which the process becomes runnable in demoted queue
-          //updated properties of process.........
-        }
-      }
-      release(&p->lock);
-    }
-
-    struct proc *min;
-    struct proc *debug = proc;
-    acquire(&debug->lock);
-    int flag = min->w_time;
-    flag=0;
-    for (int q = 0; q < 5; q++) //moving through the queues starting from 0;
-    {
-      for (p = proc; p < &proc[NPROC]; p++) //searcher loop
-      {
-        //acquire(&p->lock);
-        if (p->state == RUNNABLE)
-        {
-          if (p->q_num == q) // this is the first encounter
-          {
-            flag = 1;
-            min = p;
-          }
-        }
-        //release(&p->lock);
-        if (flag == 1)
-          break;
-      }
-      if (flag == 1)
-        break;
-    }
-    
-
-    /*if (flag == 1)
-    {
-      //acquire(&min->lock);
-      flag = 0;
-      if (min != 0)
-      {
-        if (lastproc != min->pid)
-        {
-          min->n_run++;
-          lastproc = min->pid;
-        }
-        min->w_time=0;
-
-        min->state = RUNNING;
-        c->proc = min;
-        swtch(&c->context, &min->context);
-        c->proc = 0;
-      }
-      //release(&min->lock);
-    }*/
-    release(&debug->lock);
-
-    // RR DEBUGGING
-    for (p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-      if (p->state == RUNNABLE)
-      {
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-        if (lastproc != p->pid)
-        {
-          p->n_run++;
-          lastproc = p->pid;
-        }
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
-
-#endif
+    release(&p->lock);
   }
 }
 
@@ -786,13 +989,72 @@ void yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
-  p->s_time = ticks;
-  p->w_time = 0;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
 
+// Mark p RUNNABLE and put it on a run queue.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  int niceness;
+
+  account(p);
+  p->state = RUNNABLE;
+  p->s_time = ticks;
+
+  // PBS: r_time and iow_time only change while p is off the
+  // run queues, so its DP can be settled here for its whole
+  // stay on one.
+  niceness = 5;
+  if (p->iow_time + p->r_time != 0)
+    niceness = 10 * p->iow_time / (p->iow_time + p->r_time);
+  p->DP = maxi(0, mini(p->SP - niceness + 5, 100));
+
+  runqadd(p);
+}
+
+// Charge the ticks, and mtime cycles, since p's last state
+// change to the state it has been in. Called with p->lock
+// held just before p changes state, which for RUNNING is
+// right around the swtch() in scheduler() or sched(), so
+// the totals are kept without any per-tick work; the current
+// state's share is pending(p).
+static void
+account(struct proc *p)
+{
+  int n = pending(p);
+  uint64 now = *(uint64 *)CLINT_MTIME;
+  uint64 c = now - p->mstamp;
+
+  p->stamp = ticks;
+  p->mstamp = now;
+  if (p->state == RUNNING)
+  {
+    p->r_time += n;
+    p->runcycles += c;
+  }
+  else if (p->state == SLEEPING)
+  {
+    p->iow_time += n;
+    p->sleepcycles += c;
+  }
+  else if (p->state == RUNNABLE)
+  {
+    p->tot_wtime += n;
+    p->waitcycles += c;
+  }
+}
+
+// Ticks p has spent in its current state so far.
+static int
+pending(struct proc *p)
+{
+  return ticks - p->stamp;
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 void forkret(void)
@@ -820,31 +1082,52 @@ void forkret(void)
 void sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q = sleepqof(chan);
 
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once we hold q->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks q->lock, then p->lock),
   // so it's okay to release lk.
 
-  acquire(&p->lock); //DOC: sleeplock1
+  acquire(&q->lock); //DOC: sleeplock1
+  acquire(&p->lock);
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
+  p->sprev = 0;
+  p->snext = q->head;
+  if (q->head)
+    q->head->sprev = p;
+  q->head = p;
+  account(p);
   p->state = SLEEPING;
-#ifdef MLFQ
   p->ticks[p->q_num] = 0;
-#endif
+  release(&q->lock);
 
   sched();
 
-  // Tidy up.
+  // Tidy up. Whoever woke us (wakeup, wakeproc or kill)
+  // left us on the queue; a waker that still finds us
+  // there sees we are no longer SLEEPING and skips us.
+  release(&p->lock);
+  acquire(&q->lock);
+  if (p->sprev)
+    p->sprev->snext = p->snext;
+  else
+    q->head = p->snext;
+  if (p->snext)
+    p->snext->sprev = p->sprev;
+  p->snext = p->sprev = 0;
+  release(&q->lock);
+
+  acquire(&p->lock);
   p->chan = 0;
+  release(&p->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -853,22 +1136,35 @@ void sleep(void *chan, struct spinlock *lk)
 //SNXX: has to update stime here
 void wakeup(void *chan)
 {
+  struct sleepq *q = sleepqof(chan);
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++)
+  acquire(&q->lock);
+  for (p = q->head; p; p = p->snext)
   {
     if (p != myproc())
     {
       acquire(&p->lock);
       if (p->state == SLEEPING && p->chan == chan)
       {
-        p->state = RUNNABLE;
-        p->s_time = ticks;
-        p->w_time = 0;
+        setrunnable(p);
       }
       release(&p->lock);
     }
   }
+  release(&q->lock);
+}
+
+// Wake p if it is sleeping on chan. Unlike wakeup(), for
+// callers that already know which process to wake.
+void wakeproc(struct proc *p, void *chan)
+{
+  acquire(&p->lock);
+  if (p->state == SLEEPING && p->chan == chan)
+  {
+    setrunnable(p);
+  }
+  release(&p->lock);
 }
 
 // Kill the process with the given pid.
@@ -879,25 +1175,16 @@ int kill(int pid)
 {
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++)
+  if ((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if (p->state == SLEEPING)
   {
-    acquire(&p->lock);
-    if (p->pid == pid)
-    {
-      p->killed = 1;
-      if (p->state == SLEEPING)
-      {
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-        p->s_time = ticks;
-        p->w_time = 0;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -948,9 +1235,11 @@ void procdump(void)
   struct proc *p;
   char *state1;
   int headcount = 1;
+  int rtime, wtime;
 
   printf("\n");
-  for (p = proc; p < &proc[NPROC]; p++)
+  printf("policy %s\n", policyname());
+  for (p = allproc; p; p = p->allnext)
   {
     if (p->state == UNUSED)
       continue;
@@ -959,49 +1248,53 @@ void procdump(void)
     else
       state1 = "???";
 
-#ifdef PBS
-    if (headcount == 1)
-    {
-      printf("PID        Priority        State        rtime        wtime        nrun\n");
-      headcount++;
-    }
+    rtime = p->r_time + (p->state == RUNNING ? pending(p) : 0);
+    wtime = p->tot_wtime + (p->state == RUNNABLE ? pending(p) : 0);
 
-    printf("%d             %d           %s           %d            %d          %d\n", p->pid, p->DP, state1, p->r_time, p->tot_wtime, p->n_run);
-    printf("\n");
-#endif
-
-#ifdef MLFQ
-    if (headcount == 1)
+    if (policy == SCHED_PBS)
     {
-      printf("PID        Priority        State        rtime        wtime        nrun\n");
-      headcount++;
-    }
-
-    printf("%d             %d           %s           %d            %d          %d\n", p->pid, p->q_num, state1, p->r_time, p->w_time, p->n_run);
-    printf("\n");
-#endif
+      if (headcount == 1)
+      {
+        printf("PID        Priority        State        rtime        wtime        nrun        migr\n");
+        headcount++;
+      }
 
-#ifdef FCFS
-    if (headcount == 1)
-    {
-      printf("PID        State        rtime        wtime        nrun\n");
-      headcount++;
+      printf("%d             %d           %s           %d            %d          %d          %d\n", p->pid, p->DP, state1, rtime, wtime, p->n_run, p->migrations);
+      printf("\n");
     }
+    else if (policy == SCHED_STRIDE)
+    {
+      if (headcount == 1)
+      {
+        printf("PID        Tickets        State        rtime        wtime        nrun        migr\n");
+        headcount++;
+      }
 
-    printf("%d             %s          %d            %d          %d\n", p->pid, state1, p->r_time, p->tot_wtime, p->n_run);
-    printf("\n");
-#endif
-
-#ifdef RR
-    if (headcount == 1)
+      printf("%d             %d           %s           %d            %d          %d          %d\n", p->pid, p->tickets, state1, rtime, wtime, p->n_run, p->migrations);
+      printf("\n");
+    }
+    else if (policy == SCHED_MLFQ)
     {
-      printf("PID        State        rtime        wtime        nrun\n");
-      headcount++;
+      if (headcount == 1)
+      {
+        printf("PID        Priority        State        rtime        wtime        nrun        migr\n");
+        headcount++;
+      }
+
+      printf("%d             %d           %s           %d            %d          %d          %d\n", p->pid, p->q_num, state1, rtime, p->state == RUNNABLE ? ticks - p->s_time : 0, p->n_run, p->migrations);
+      printf("\n");
     }
+    else
+    {
+      if (headcount == 1)
+      {
+        printf("PID        State        rtime        wtime        nrun        migr\n");
+        headcount++;
+      }
 
-    printf("%d             %s          %d            %d          %d\n", p->pid, state1, p->r_time, p->tot_wtime, p->n_run);
-    printf("\n");
-#endif
+      printf("%d             %s          %d            %d          %d          %d\n", p->pid, state1, rtime, wtime, p->n_run, p->migrations);
+      printf("\n");
+    }
   }
 }
 int maxi(int a, int b)
@@ -1019,73 +1312,169 @@ int mini(int a, int b)
     return b;
 }
 
-void updatetime()
+int procsetpriority(int pid, int priority)
 {
   struct proc *p;
-  for (p = proc; p < &proc[NPROC]; p++)
-  {
-    acquire(&p->lock);
-    if (p->state == RUNNING)
-    {
-      p->r_time += 1;
-#ifdef MLFQ
-      if (p->q_num >= 0)
-      {
-        p->ticks[p->q_num] += 1;
-        p->total_ticks[p->q_num] += 1;
-      }
-#endif
-    }
-
-    if (p->state == SLEEPING)
-      p->iow_time += 1;
-
-    if (p->state == RUNNABLE)
-    {
-      p->tot_wtime += 1;
-      p->w_time += 1;
-    }
-
-    int niceness = 10 * p->iow_time;
-    if (p->iow_time + p->r_time != 0)
-      niceness = niceness / (p->iow_time + p->r_time);
-    else
-      niceness = 5;
-    p->DP = maxi(0, mini(p->SP - niceness + 5, 100));
 
+  if ((p = findproc(pid)) == 0)
+    return -1;
+  if (policy == SCHED_STRIDE)
+  {
+    // under stride scheduling the value is a ticket count;
+    // more than STRIDE1 tickets would make the stride 0.
+    int oldtickets = p->tickets;
+    p->tickets = maxi(1, mini(priority, STRIDE1));
     release(&p->lock);
+    return oldtickets;
   }
+  int oldpriority = p->SP;
+  p->niceness = 5;
+  p->SP = priority;
+  p->DP = maxi(0, mini(p->SP, 100));
+  if (p->state == RUNNABLE)
+    runqupdate(p);
+  release(&p->lock);
+  if (p->DP < oldpriority)
+    yield();
+  return oldpriority;
 }
 
-int procsetpriority(int pid, int priority)
+// Move process pid to scheduling class cls (CLASS_* in sched.h).
+// Returns the old class, or -1 if there is no such process or class.
+// Only setdeadline() can put a process in CLASS_EDF.
+int procsetclass(int pid, int cls)
 {
   struct proc *p;
-  int flag = 0;
-  for (p = proc; p < &proc[NPROC]; p++)
+  int oldcls;
+
+  if (cls < 0 || cls >= NCLASS || cls == CLASS_EDF)
+    return -1;
+
+  if ((p = findproc(pid)) == 0)
+    return -1;
+  oldcls = p->cls;
+  runqsetclass(p, cls);
+  if (oldcls == CLASS_EDF)
+    edfleave(p);
+  release(&p->lock);
+  // let higher class work run if we demoted ourselves.
+  if (p == myproc() && cls > oldcls)
+    yield();
+  return oldcls;
+}
+
+// Make the calling process a CLASS_EDF process that needs
+// runtime ticks of cpu every period ticks, each job finished
+// within deadline ticks of its release. runtime 0 puts it
+// back in CLASS_NORMAL.
+// Returns 0, or -1 if the parameters are bad or admitting
+// the process would exceed EDFUTIL.
+int procsetdeadline(int runtime, int period, int deadline)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  if (runtime == 0)
   {
-    acquire(&p->lock);
-    if (p->pid == pid)
+    if (p->cls == CLASS_EDF)
     {
-      flag = 1;
-      release(&p->lock);
-      break;
+      runqsetclass(p, CLASS_NORMAL);
+      edfleave(p);
     }
     release(&p->lock);
+    return 0;
   }
-  if (flag == 0)
+  if (runtime < 0 || deadline < runtime || period < deadline ||
+      edfadmit(p, runtime, deadline) < 0)
   {
+    release(&p->lock);
     return -1;
   }
+  p->dl_runtime = runtime;
+  p->dl_period = period;
+  p->dl_deadline = deadline;
+  p->dl_start = ticks;
+  p->dl_abs = ticks + deadline;
+  p->dl_used = 0;
+  runqsetclass(p, CLASS_EDF);
+  release(&p->lock);
+  return 0;
+}
+
+// Copy the calling process's CPU usage, or that of its
+// waited-for children (who is RUSAGE_*), to struct rusage
+// at user address addr.
+// Returns 0, or -1 on a bad who or address.
+int procrusage(int who, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct rusage ru;
+  uint64 ns = 1000000000 / MTIMEHZ;
+
+  acquire(&p->lock);
+  if (who == RUSAGE_SELF)
+  {
+    // charge the time slice in progress.
+    account(p);
+    ru.runtime = p->runcycles * ns;
+    ru.waittime = p->waitcycles * ns;
+    ru.sleeptime = p->sleepcycles * ns;
+    ru.nswitch = p->nswitch;
+  }
+  else if (who == RUSAGE_CHILDREN)
+  {
+    ru.runtime = p->cruncycles * ns;
+    ru.waittime = p->cwaitcycles * ns;
+    ru.sleeptime = p->csleepcycles * ns;
+    ru.nswitch = p->cnswitch;
+  }
   else
   {
-    acquire(&p->lock);
-    int oldpriority = p->SP;
-    p->niceness = 5;
-    p->SP = priority;
-    p->DP = maxi(0, mini(p->SP, 100));
     release(&p->lock);
-    if (p->DP < oldpriority)
-      yield();
-    return oldpriority;
+    return -1;
   }
+  release(&p->lock);
+
+  if (copyout(p->pagetable, addr, (char *)&ru, sizeof(ru)) < 0)
+    return -1;
+  return 0;
+}
+
+// Restrict process pid to the cpus in mask, bit i for cpus[i].
+// Returns 0, or -1 if there is no such process or mask holds
+// no cpu that is scheduling.
+int procsetaffinity(int pid, uint64 mask)
+{
+  struct proc *p;
+  struct cpu *c;
+
+  for (c = cpus; c < &cpus[NCPU]; c++)
+  {
+    if (c->online && (mask & (1UL << (c - cpus))))
+      break;
+  }
+  if (c == &cpus[NCPU])
+    return -1;
+
+  if ((p = findproc(pid)) == 0)
+    return -1;
+  runqsetaffinity(p, mask);
+  release(&p->lock);
+  // get off this cpu if it is no longer allowed.
+  if (p == myproc())
+    yield();
+  return 0;
+}
+
+// The cpu mask of process pid, or -1 if there is none.
+int procgetaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if ((p = findproc(pid)) == 0)
+    return -1;
+  mask = p->affinity & ((1UL << NCPU) - 1);
+  release(&p->lock);
+  return mask;
 }
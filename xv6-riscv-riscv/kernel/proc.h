@@ -18,12 +18,40 @@ struct context {
   uint64 s11;
 };
 
+// FIFO of processes linked through p->rqnext.
+struct procq {
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Per-CPU queue of RUNNABLE processes, see sched.c.
+struct runq {
+  struct spinlock lock;
+  struct procq dl;            // CLASS_EDF processes, by absolute deadline
+  struct procq rt;            // CLASS_RT processes
+  struct procq q[NQUEUE];     // CLASS_NORMAL: MLFQ uses one per level, others q[0]
+  struct proc *heap[NPROC];   // CLASS_NORMAL under PBS/STRIDE: min-heap
+  int nheap;                  // Processes in heap
+  struct procq batch;         // CLASS_BATCH processes
+  struct procq idle;          // CLASS_IDLE processes
+  int cpu;                    // Index of the cpu this queue belongs to
+  int nclass[NCLASS];         // Queued processes per class
+  int len;                    // Number of queued processes
+  uint64 vtime;               // STRIDE: pass of the process running when last ticked
+  int nallowed[NCPU];         // Queued processes each cpu may run
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int online;                 // Has this cpu entered scheduler()?
+  int idle;                   // Waiting in runqidle() for work?
+  uint kstackgen;             // kstackgen at this cpu's last TLB flush
+  uint userseq;               // Bumped entering and leaving user space; odd in it
+  struct runq rq;             // RUNNABLE processes waiting for this cpu.
 };
 
 extern struct cpu cpus[NCPU];
@@ -93,22 +121,57 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
+  // pid_lock must be held when using these:
+  struct proc *pidnext;        // Next in p's pidhash chain
+  uint64 kstack;               // Virtual address of kernel stack, or 0 until first used
+
+  // set once when the struct is allocated:
+  int idx;                     // Slot number, for KSTACK() and THREADFRAME()
+  struct proc *allnext;        // Next in allproc
+
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
 
+  // rq->lock must be held when using these:
+  struct runq *rq;             // Run queue holding this process, or null
+  struct proc *rqnext;         // Links in rq
+  struct proc *rqprev;
+  int rqidx;                   // PBS: index in rq->heap
+
+  // p->lock, and rq->lock if queued, must be held to change this:
+  int cls;                     // Scheduling class, CLASS_*
+  uint64 affinity;             // Cpus p may run on, bit i for cpus[i]
+
   // these are private to the process, so p->lock need not be held.
-  uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // User address of trapframe: TRAPFRAME, or THREADFRAME() in a thread
+  int thread;                  // Created by clone(), sharing its parent's pagetable
+  uint64 ustack;               // Thread: user stack given to clone()
+
+  // the futex wait queue's lock must be held when using these:
+  uint64 futex;                // Physical address of the futex p waits on, or 0
+  struct proc *fnext;          // Next waiter in the futex wait queue
+
+  // the sleep queue's lock must be held when using these:
+  struct proc *snext;          // Links in the sleep queue of p->chan
+  struct proc *sprev;
+
+  // the timer lock must be held when using these:
+  uint64 wakeat;               // mtime at which p's timed sleep ends
+  int timeridx;                // Index in the timer heap, or -1
+
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
+  struct fdtable *fdt;         // Open files, shared with threads
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 
   //adding my variables here____________________________________________________________________
-  int mask;
+  uint64 mask;    // syscalls to trace, bit n for syscall n
+  int sysproc;     // init or the console shell it forks
   int c_time;      // When was the process created
+  uint stamp;      // ticks at the last state change; see account()
   int iow_time;    // time for which process is SLEEPING.
   int tot_wtime;   // total waittime for cpu for a process.
   int r_time;      // how long the process is running
@@ -117,17 +180,46 @@ struct proc {
   int DP;          // Dyanamci priority or net priority
   int niceness;    // niceness value 
   int n_run;       // number of times a process is picked by a  cpu
+  int runticks;    // ticks since last picked by a cpu
+  int lastcpu;     // cpu p last ran on, or -1
+  int migrations;  // times p ran on a different cpu than the last time
+
+  //mtime accounting, for getrusage()
+  uint64 mstamp;          // mtime at the last state change
+  uint64 runcycles;       // mtime cycles spent RUNNING
+  uint64 waitcycles;      // ... RUNNABLE
+  uint64 sleepcycles;     // ... SLEEPING
+  uint64 nswitch;         // times switched to by a cpu
+  uint64 cruncycles;      // the same, summed over waited-for children
+  uint64 cwaitcycles;
+  uint64 csleepcycles;
+  uint64 cnswitch;
+
+  //STRIDE
+  int tickets;            // share of the cpu, relative to other processes
+  uint64 pass;            // virtual time; advances by STRIDE1/tickets per tick run
+
+  //EDF
+  int dl_runtime;         // ticks of cpu a job may use per period
+  int dl_period;          // ticks between job releases
+  int dl_deadline;        // ticks after its release by which a job must finish
+  uint dl_start;          // release time of the current job
+  uint dl_abs;            // absolute deadline of the current job
+  int dl_used;            // ticks the current job has run
 
   //MLFQ
   int s_time;             // When was the process started becomes runnable i.e,wating for cpu; resets to zero when running started
-  int ticks[5];           // Ticks completed in ith que => ticks[i]; reset to zero when queue is changed
-  int total_ticks[5];     // Total ticks received by the process while it is running (RUNNING) in particular queue.
+  int ticks[NQUEUE];      // Ticks completed in ith que => ticks[i]; reset to zero when queue is changed
+  int total_ticks[NQUEUE]; // Total ticks received by the process while it is running (RUNNING) in particular queue.
   int q_num;              // The que in which the process is present
-  int w_time;             //wait time for cpu. reset to zero when the process runs on a cpu or changes queue.
 
 
 
 };
 
-void updatetime();
-int procsetpriority(int pid, int priority);
\ No newline at end of file
+int procsetpriority(int pid, int priority);
+int procsetclass(int pid, int cls);
+int procsetdeadline(int runtime, int period, int deadline);
+int procrusage(int who, uint64 addr);
+int procsetaffinity(int pid, uint64 mask);
+int procgetaffinity(int pid);
@@ -283,6 +283,14 @@ intr_off()
   w_sstatus(r_sstatus() & ~SSTATUS_SIE);
 }
 
+// wait until an interrupt is pending, even if
+// device interrupts are disabled.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // are device interrupts enabled?
 static inline int
 intr_get()
@@ -343,6 +351,7 @@ sfence_vma()
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
+#define PTE_COW (1L << 8) // software bit: copy this page on the next write
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
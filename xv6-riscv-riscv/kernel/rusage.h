@@ -0,0 +1,11 @@
+#define RUSAGE_SELF     0  // the calling process
+#define RUSAGE_CHILDREN 1  // its waited-for children, and theirs
+
+// CPU accounting, for getrusage(). Times are in nanoseconds,
+// measured with the CLINT's mtime counter at each state change.
+struct rusage {
+  uint64 runtime;   // RUNNING on a cpu
+  uint64 waittime;  // RUNNABLE, waiting for a cpu
+  uint64 sleeptime; // SLEEPING
+  uint64 nswitch;   // times switched to by a cpu
+};
@@ -0,0 +1,1046 @@
+// Per-CPU run queues and scheduling policies.
+//
+// Every RUNNABLE process sits on exactly one cpu's run queue,
+// so scheduler() only ever looks at processes that can run,
+// and harts don't fight over the whole process table.
+// An idle cpu steals from the cpu with the most queued
+// processes it may run, and with nothing left to steal it
+// turns off its timer and waits in wfi until runqadd() kicks it.
+// A process only ever joins or is stolen onto a cpu in its
+// p->affinity, and returns to the cpu it last ran on when
+// that is not much worse than the best choice.
+//
+// Each process has a scheduling class (p->cls, see sched.h).
+// A cpu runs its queued CLASS_EDF processes first, earliest
+// absolute deadline first, then CLASS_RT in FIFO order and
+// without timeslicing, then CLASS_NORMAL, then CLASS_BATCH,
+// then CLASS_IDLE.
+//
+// How CLASS_NORMAL is ordered is up to the current policy,
+// a struct schedclass chosen at boot by make SCHEDULER=...
+// and switchable at run time with setsched(). RR keeps one
+// FIFO, FCFS one list sorted by creation time, MLFQ one FIFO
+// per priority level (indexed by q_num), and PBS and STRIDE a
+// binary heap, so the next process is always at the front.
+//
+// Lock order is p->lock, then rq->lock, then other cpus'
+// rq->locks in cpu order. A process is queued with its
+// p->lock held; scheduler() pops it holding only rq->lock
+// and then acquires p->lock before running it.
+// Queued processes are RUNNABLE and can't change queues on
+// their own, so MLFQ aging rewrites their q_num and s_time
+// under rq->lock alone.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sched.h"
+#include "defs.h"
+
+int WTIME = 500;                 // MLFQ: ticks a process may wait before aging
+int slice[5] = {1, 2, 4, 8, 16}; // MLFQ: quantum for each queue
+
+// A scheduling policy. Except for tick, the hooks are
+// called with rq->lock held; runqinsert() and runqremove()
+// take care of p->rq and rq->len.
+struct schedclass {
+  char *name;
+  void (*enqueue)(struct runq*, struct proc*);
+  void (*dequeue)(struct runq*, struct proc*);
+  struct proc* (*pick)(struct runq*);          // next to run, left queued
+  void (*requeue)(struct runq*, struct proc*); // p's key changed
+  int (*tick)(struct proc*);                   // should running p yield?
+};
+
+// Boot-time policy, from make SCHEDULER=...
+#if defined(FCFS)
+int policy = SCHED_FCFS;
+#elif defined(PBS)
+int policy = SCHED_PBS;
+#elif defined(MLFQ)
+int policy = SCHED_MLFQ;
+#else
+int policy = SCHED_RR;
+#endif
+
+// EDF admission control: the summed density (runtime over
+// deadline) of all CLASS_EDF processes, in thousandths of a
+// cpu, never exceeds EDFUTIL. That is within what one cpu
+// can meet, so every cpu's EDF work is feasible wherever
+// the processes end up queued.
+struct {
+  struct spinlock lock;
+  int util;
+} edf;
+
+void
+runqinit(void)
+{
+  struct cpu *c;
+  int i;
+
+  initlock(&edf.lock, "edf");
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    initlock(&c->rq.lock, "runq");
+    c->rq.cpu = c - cpus;
+    c->rq.dl.head = c->rq.dl.tail = 0;
+    c->rq.rt.head = c->rq.rt.tail = 0;
+    for(i = 0; i < NQUEUE; i++){
+      c->rq.q[i].head = 0;
+      c->rq.q[i].tail = 0;
+    }
+    c->rq.nheap = 0;
+    c->rq.batch.head = c->rq.batch.tail = 0;
+    c->rq.idle.head = c->rq.idle.tail = 0;
+    for(i = 0; i < NCLASS; i++)
+      c->rq.nclass[i] = 0;
+    c->rq.len = 0;
+  }
+}
+
+// Append p to the tail of q.
+static void
+runqappend(struct procq *q, struct proc *p)
+{
+  p->rqnext = 0;
+  p->rqprev = q->tail;
+  if(q->tail)
+    q->tail->rqnext = p;
+  else
+    q->head = p;
+  q->tail = p;
+}
+
+// Unlink p from q.
+static void
+runqunlink(struct procq *q, struct proc *p)
+{
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    q->head = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    q->tail = p->rqprev;
+  p->rqnext = 0;
+  p->rqprev = 0;
+}
+
+// Insert p into q, which is sorted by before().
+// Searches from the tail; ties keep arrival order.
+static void
+runqinsertsorted(struct procq *q, struct proc *p, int (*before)(struct proc*, struct proc*))
+{
+  struct proc *prev;
+
+  for(prev = q->tail; prev && before(p, prev); prev = prev->rqprev)
+    ;
+  if(prev == q->tail){
+    runqappend(q, p);
+    return;
+  }
+  p->rqprev = prev;
+  p->rqnext = prev ? prev->rqnext : q->head;
+  p->rqnext->rqprev = p;
+  if(prev)
+    prev->rqnext = p;
+  else
+    q->head = p;
+}
+
+//
+// RR: one FIFO, preempted every tick.
+//
+
+static void
+rr_enqueue(struct runq *rq, struct proc *p)
+{
+  runqappend(&rq->q[0], p);
+}
+
+static void
+rr_dequeue(struct runq *rq, struct proc *p)
+{
+  runqunlink(&rq->q[0], p);
+}
+
+static struct proc*
+rr_pick(struct runq *rq)
+{
+  return rq->q[0].head;
+}
+
+static void
+nop_requeue(struct runq *rq, struct proc *p)
+{
+}
+
+static int
+always_tick(struct proc *p)
+{
+  return 1;
+}
+
+static struct schedclass rr_class = {
+  "RR", rr_enqueue, rr_dequeue, rr_pick, nop_requeue, always_tick,
+};
+
+//
+// FCFS: one list sorted by creation time, never preempted.
+//
+
+// FCFS ordering: init and the console shell first, so the
+// console stays usable under a batch workload, then everyone
+// else by creation time.
+static int
+fcfsbefore(struct proc *a, struct proc *b)
+{
+  if(a->sysproc != b->sysproc)
+    return a->sysproc;
+  return a->c_time < b->c_time;
+}
+
+// newly forked processes belong at the tail,
+// where runqinsertsorted() starts looking.
+static void
+fcfs_enqueue(struct runq *rq, struct proc *p)
+{
+  runqinsertsorted(&rq->q[0], p, fcfsbefore);
+}
+
+static int
+never_tick(struct proc *p)
+{
+  return 0;
+}
+
+static struct schedclass fcfs_class = {
+  "FCFS", fcfs_enqueue, rr_dequeue, rr_pick, nop_requeue, never_tick,
+};
+
+//
+// Binary min-heap in rq->heap, used by PBS and STRIDE.
+// before(a, b) says whether a runs before b.
+//
+
+static void
+heapswap(struct runq *rq, int i, int j)
+{
+  struct proc *t;
+
+  t = rq->heap[i];
+  rq->heap[i] = rq->heap[j];
+  rq->heap[j] = t;
+  rq->heap[i]->rqidx = i;
+  rq->heap[j]->rqidx = j;
+}
+
+// Restore heap order around slot i after its key changed.
+static void
+heapfix(struct runq *rq, int i, int (*before)(struct proc*, struct proc*))
+{
+  int c;
+
+  while(i > 0 && before(rq->heap[i], rq->heap[(i-1)/2])){
+    heapswap(rq, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    c = 2*i + 1;
+    if(c >= rq->nheap)
+      break;
+    if(c+1 < rq->nheap && before(rq->heap[c+1], rq->heap[c]))
+      c++;
+    if(!before(rq->heap[c], rq->heap[i]))
+      break;
+    heapswap(rq, i, c);
+    i = c;
+  }
+}
+
+static void
+heapinsert(struct runq *rq, struct proc *p, int (*before)(struct proc*, struct proc*))
+{
+  p->rqidx = rq->nheap;
+  rq->heap[rq->nheap++] = p;
+  heapfix(rq, p->rqidx, before);
+}
+
+static void
+heapdelete(struct runq *rq, struct proc *p, int (*before)(struct proc*, struct proc*))
+{
+  int i = p->rqidx;
+
+  rq->nheap--;
+  if(i != rq->nheap){
+    rq->heap[i] = rq->heap[rq->nheap];
+    rq->heap[i]->rqidx = i;
+    heapfix(rq, i, before);
+  }
+}
+
+static struct proc*
+heap_pick(struct runq *rq)
+{
+  return rq->nheap > 0 ? rq->heap[0] : 0;
+}
+
+//
+// PBS: heap on priority, preempted every tick.
+//
+
+// PBS ordering: lower DP first, then fewer n_run,
+// then earlier c_time.
+static int
+pbsbefore(struct proc *a, struct proc *b)
+{
+  if(a->DP != b->DP)
+    return a->DP < b->DP;
+  if(a->n_run != b->n_run)
+    return a->n_run < b->n_run;
+  return a->c_time < b->c_time;
+}
+
+static void
+pbs_enqueue(struct runq *rq, struct proc *p)
+{
+  heapinsert(rq, p, pbsbefore);
+}
+
+static void
+pbs_dequeue(struct runq *rq, struct proc *p)
+{
+  heapdelete(rq, p, pbsbefore);
+}
+
+static void
+pbs_requeue(struct runq *rq, struct proc *p)
+{
+  heapfix(rq, p->rqidx, pbsbefore);
+}
+
+static struct schedclass pbs_class = {
+  "PBS", pbs_enqueue, pbs_dequeue, heap_pick, pbs_requeue, always_tick,
+};
+
+//
+// STRIDE: proportional share. Each tick a process runs
+// advances its pass by its stride, STRIDE1/tickets; the
+// heap runs the lowest pass first, so CPU time on a cpu
+// divides in proportion to tickets. rq->vtime follows the
+// pass of whatever runs, which had the lowest pass when it
+// was picked; no process joins the queue behind it.
+//
+
+static int
+stridebefore(struct proc *a, struct proc *b)
+{
+  if(a->pass != b->pass)
+    return a->pass < b->pass;
+  return a->c_time < b->c_time;
+}
+
+static void
+stride_enqueue(struct runq *rq, struct proc *p)
+{
+  // a process that slept or was just created must not
+  // make up for lost time by starving the others, even
+  // the one running now: start it no earlier than vtime.
+  if(p->pass < rq->vtime)
+    p->pass = rq->vtime;
+  heapinsert(rq, p, stridebefore);
+}
+
+static void
+stride_dequeue(struct runq *rq, struct proc *p)
+{
+  heapdelete(rq, p, stridebefore);
+}
+
+static int
+stride_tick(struct proc *p)
+{
+  struct runq *rq;
+
+  push_off();
+  rq = &mycpu()->rq;
+  if(rq->vtime < p->pass)
+    rq->vtime = p->pass;
+  pop_off();
+  p->pass += STRIDE1 / p->tickets;
+  return 1;
+}
+
+static struct schedclass stride_class = {
+  "STRIDE", stride_enqueue, stride_dequeue, heap_pick, nop_requeue, stride_tick,
+};
+
+//
+// MLFQ: one FIFO per level, demotion on a used-up quantum,
+// aging after WTIME ticks of waiting.
+//
+
+static void
+mlfq_enqueue(struct runq *rq, struct proc *p)
+{
+  // demote a process that used up its quantum.
+  if(p->ticks[p->q_num] >= slice[p->q_num]){
+    p->ticks[p->q_num] = 0;
+    if(p->q_num < NQUEUE-1)
+      p->q_num++;
+    p->s_time = ticks;
+  }
+  runqappend(&rq->q[p->q_num], p);
+}
+
+static void
+mlfq_dequeue(struct runq *rq, struct proc *p)
+{
+  runqunlink(&rq->q[p->q_num], p);
+}
+
+static struct proc*
+mlfq_pick(struct runq *rq)
+{
+  struct proc *p;
+  int i;
+
+  // aging: each FIFO is in s_time order, so its head has
+  // waited longest. promote heads that waited over WTIME.
+  for(i = 1; i < NQUEUE; i++){
+    while((p = rq->q[i].head) != 0 && ticks - p->s_time > WTIME){
+      runqunlink(&rq->q[i], p);
+      p->ticks[i] = 0;
+      p->q_num = i - 1;
+      p->s_time = ticks;
+      runqappend(&rq->q[i-1], p);
+    }
+  }
+
+  // head of the highest priority non-empty queue.
+  for(i = 0; i < NQUEUE; i++){
+    if(rq->q[i].head)
+      return rq->q[i].head;
+  }
+  return 0;
+}
+
+static int
+mlfq_tick(struct proc *p)
+{
+  struct runq *rq;
+  int i, preempt;
+
+  // out of quantum: yield, and mlfq_enqueue() demotes it.
+  if(p->ticks[p->q_num] >= slice[p->q_num])
+    return 1;
+
+  // otherwise only a higher priority queue preempts it.
+  preempt = 0;
+  push_off();
+  rq = &mycpu()->rq;
+  for(i = 0; i < p->q_num; i++){
+    if(rq->q[i].head)
+      preempt = 1;
+  }
+  pop_off();
+  return preempt;
+}
+
+static struct schedclass mlfq_class = {
+  "MLFQ", mlfq_enqueue, mlfq_dequeue, mlfq_pick, nop_requeue, mlfq_tick,
+};
+
+//
+// EDF class: one list per cpu sorted by absolute deadline.
+// A process runs periodic jobs of dl_runtime ticks, each due
+// dl_deadline ticks after its release; one is released every
+// dl_period ticks. Jobs are released lazily, whenever the
+// process is looked at, rather than by a timer.
+//
+
+// Start p's current job if its period has come around.
+static void
+edfrenew(struct proc *p)
+{
+  uint n;
+
+  if(ticks - p->dl_start >= p->dl_period){
+    n = (ticks - p->dl_start) / p->dl_period;
+    p->dl_start += n * p->dl_period;
+    p->dl_abs = p->dl_start + p->dl_deadline;
+    p->dl_used = 0;
+  }
+}
+
+static int
+edfbefore(struct proc *a, struct proc *b)
+{
+  return (int)(a->dl_abs - b->dl_abs) < 0;
+}
+
+// runtime/deadline in thousandths, rounded up so that tiny
+// reservations still count. runtime <= deadline, so the
+// result fits, but runtime * 1000 might not.
+static int
+edfdensity(int runtime, int deadline)
+{
+  return ((uint64)runtime * 1000 + deadline - 1) / deadline;
+}
+
+// Admit p to CLASS_EDF with the given parameters, in ticks,
+// if that keeps the EDF total within EDFUTIL.
+// p's own current reservation, if any, is replaced.
+// Returns 0, or -1 if p is refused.
+int
+edfadmit(struct proc *p, int runtime, int deadline)
+{
+  int old, new;
+
+  old = p->cls == CLASS_EDF ? edfdensity(p->dl_runtime, p->dl_deadline) : 0;
+  new = edfdensity(runtime, deadline);
+  acquire(&edf.lock);
+  if(edf.util - old + new > EDFUTIL){
+    release(&edf.lock);
+    return -1;
+  }
+  edf.util += new - old;
+  release(&edf.lock);
+  return 0;
+}
+
+// Give back the reservation of p, which is leaving CLASS_EDF.
+void
+edfleave(struct proc *p)
+{
+  acquire(&edf.lock);
+  edf.util -= edfdensity(p->dl_runtime, p->dl_deadline);
+  release(&edf.lock);
+}
+
+// Called on the way back to user space: if p's job has used
+// its runtime, sleep until the next one is released, so an
+// overrunning EDF process can't eat into other budgets.
+void
+edfthrottle(struct proc *p)
+{
+  uint left;
+
+  for(;;){
+    acquire(&p->lock);
+    edfrenew(p);
+    left = p->dl_start + p->dl_period - ticks;
+    if(p->cls != CLASS_EDF || p->dl_used < p->dl_runtime || p->killed){
+      release(&p->lock);
+      return;
+    }
+    release(&p->lock);
+    timerwait(*(uint64*)CLINT_MTIME + (uint64)left * TICKCYCLES);
+  }
+}
+
+static struct schedclass *classes[NSCHED] = {
+[SCHED_RR]    &rr_class,
+[SCHED_FCFS]  &fcfs_class,
+[SCHED_PBS]   &pbs_class,
+[SCHED_MLFQ]  &mlfq_class,
+[SCHED_STRIDE] &stride_class,
+};
+
+// May p run on cpu c?
+static int
+allowed(struct proc *p, struct cpu *c)
+{
+  return (p->affinity & (1UL << (c - cpus))) != 0;
+}
+
+// Count p, which is joining (d = 1) or leaving (d = -1) rq,
+// in rq->nallowed of every cpu it may run on.
+// rq->lock must be held.
+static void
+runqcount(struct runq *rq, struct proc *p, int d)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    if(p->affinity & (1UL << i))
+      rq->nallowed[i] += d;
+}
+
+// Is a better than b as a place to queue a process?
+// Idle cpus don't steal, so they must be given work first.
+static int
+runqbetter(struct cpu *a, struct cpu *b)
+{
+  if(a->idle != b->idle)
+    return a->idle;
+  return a->rq.len < b->rq.len;
+}
+
+// Choose the cpu whose queue p, newly RUNNABLE, joins: the
+// best of the scheduling cpus that p may run on, with ties
+// going to this cpu. The cpu p last ran on wins instead
+// unless it is busy while another is idle or its queue is
+// more than one longer, so p keeps its cache warm.
+// The lengths are read without locks; a stale value only
+// makes the choice less balanced.
+// Interrupts must be disabled.
+static struct cpu*
+runqselect(struct proc *p)
+{
+  struct cpu *c, *me, *best, *last;
+
+  me = mycpu();
+  best = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->online || !allowed(p, c))
+      continue;
+    if(best == 0 || runqbetter(c, best) || (c == me && !runqbetter(best, c)))
+      best = c;
+  }
+  if(best == 0){
+    // early in boot, before any cpu is scheduling.
+    return me;
+  }
+
+  if(p->lastcpu >= 0){
+    last = &cpus[p->lastcpu];
+    if(last != best && last->online && allowed(p, last) &&
+       (last->idle || !best->idle) && last->rq.len <= best->rq.len + 1)
+      best = last;
+  }
+  return best;
+}
+
+// Add p to rq: its class's FIFO, or for CLASS_NORMAL
+// wherever the current policy puts it.
+// rq->lock must be held.
+static void
+runqinsert(struct runq *rq, struct proc *p)
+{
+  p->rq = rq;
+  switch(p->cls){
+  case CLASS_EDF:
+    edfrenew(p);
+    runqinsertsorted(&rq->dl, p, edfbefore);
+    break;
+  case CLASS_RT:
+    runqappend(&rq->rt, p);
+    break;
+  case CLASS_NORMAL:
+    classes[policy]->enqueue(rq, p);
+    break;
+  case CLASS_BATCH:
+    runqappend(&rq->batch, p);
+    break;
+  default:
+    runqappend(&rq->idle, p);
+    break;
+  }
+  rq->nclass[p->cls]++;
+  rq->len++;
+  runqcount(rq, p, 1);
+}
+
+// Take p out of rq.
+// rq->lock must be held.
+static void
+runqremove(struct runq *rq, struct proc *p)
+{
+  switch(p->cls){
+  case CLASS_EDF:
+    runqunlink(&rq->dl, p);
+    break;
+  case CLASS_RT:
+    runqunlink(&rq->rt, p);
+    break;
+  case CLASS_NORMAL:
+    classes[policy]->dequeue(rq, p);
+    break;
+  case CLASS_BATCH:
+    runqunlink(&rq->batch, p);
+    break;
+  default:
+    runqunlink(&rq->idle, p);
+    break;
+  }
+  rq->nclass[p->cls]--;
+  rq->len--;
+  runqcount(rq, p, -1);
+  p->rq = 0;
+}
+
+// The process to run next from rq, left queued,
+// or 0 if rq is empty. Higher classes always go first.
+// rq->lock must be held.
+static struct proc*
+runqpeek(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = rq->dl.head) == 0 &&
+     (p = rq->rt.head) == 0 &&
+     (p = classes[policy]->pick(rq)) == 0 &&
+     (p = rq->batch.head) == 0 &&
+     (p = rq->idle.head) == 0)
+    return 0;
+  return p;
+}
+
+// Remove and return the process to run next from rq,
+// or 0 if rq is empty.
+// rq->lock must be held.
+static struct proc*
+runqtake(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = runqpeek(rq)) != 0)
+    runqremove(rq, p);
+  return p;
+}
+
+// Put p, which has just become RUNNABLE, on a run queue.
+// Caller must hold p->lock.
+void
+runqadd(struct proc *p)
+{
+  struct cpu *c;
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqadd lock");
+  if(p->state != RUNNABLE)
+    panic("runqadd state");
+
+  c = runqselect(p);
+  rq = &c->rq;
+  acquire(&rq->lock);
+  runqinsert(rq, p);
+  release(&rq->lock);
+
+  // pairs with runqidle(): either c sees p queued
+  // before it sleeps, or we see c idle and wake it.
+  __sync_synchronize();
+  if(c != mycpu() && c->idle)
+    cpukick(c);
+}
+
+// The scheduling key of p changed (e.g. its DP);
+// move it to its new place if it is queued.
+// Only CLASS_NORMAL processes have keys.
+// Caller must hold p->lock, which keeps p from being
+// queued anywhere else meanwhile.
+void
+runqupdate(struct proc *p)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqupdate lock");
+  if((rq = p->rq) == 0)
+    return;
+
+  acquire(&rq->lock);
+  if(p->rq == rq && p->cls == CLASS_NORMAL)
+    classes[policy]->requeue(rq, p);
+  release(&rq->lock);
+}
+
+// Virtual time of this cpu's queue, for a new process's
+// pass under STRIDE.
+uint64
+runqvtime(void)
+{
+  uint64 v;
+
+  push_off();
+  v = mycpu()->rq.vtime;
+  pop_off();
+  return v;
+}
+
+// Called on each timer interrupt taken while p is RUNNING.
+// Returns 1 if p should give up the cpu.
+int
+runqtick(struct proc *p)
+{
+  struct runq *rq;
+  int y;
+
+  // charge the tick to p; only this cpu touches these
+  // while p runs.
+  p->runticks++;
+  p->ticks[p->q_num]++;
+  p->total_ticks[p->q_num]++;
+
+  push_off();
+  rq = &mycpu()->rq;
+  switch(p->cls){
+  case CLASS_EDF:
+    // charge the tick to the current job; yield when its
+    // budget is spent or an earlier deadline is waiting.
+    edfrenew(p);
+    p->dl_used++;
+    y = p->dl_used >= p->dl_runtime ||
+        (rq->dl.head && edfbefore(rq->dl.head, p));
+    break;
+  case CLASS_RT:
+    // runs until it sleeps or yields.
+    y = rq->nclass[CLASS_EDF] > 0;
+    break;
+  case CLASS_NORMAL:
+    // the policy accounts for every tick, even one lost
+    // to a higher class.
+    y = classes[policy]->tick(p);
+    y = y || rq->nclass[CLASS_EDF] > 0 || rq->nclass[CLASS_RT] > 0;
+    break;
+  case CLASS_BATCH:
+    // batch peers only get a turn once the slice is over.
+    y = rq->nclass[CLASS_EDF] > 0 || rq->nclass[CLASS_RT] > 0 ||
+        rq->nclass[CLASS_NORMAL] > 0 ||
+        (p->runticks >= BATCHSLICE && rq->nclass[CLASS_BATCH] > 0);
+    break;
+  default:
+    y = rq->len > 0;
+    break;
+  }
+  pop_off();
+  return y;
+}
+
+// Called by cpu c when it found nothing to run or steal.
+// Zero a page for kzalloc() if any are wanted, and return
+// to look for work again. Otherwise, unless some queue holds
+// a process c may run (its lock was busy when we tried to
+// steal), wait in wfi for an interrupt: a device,
+// a tick, or a kick from runqadd(). Every cpu but cpu 0,
+// which keeps ticks for everyone, turns its timer off first,
+// so an idle hart takes no timer interrupts at all.
+void
+runqidle(struct cpu *c)
+{
+  struct cpu *v;
+
+  if(kzerofill())
+    return;
+
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v->online && v->rq.nallowed[c - cpus] > 0)
+      break;
+  }
+  if(v == &cpus[NCPU]){
+    if(cpuid() == 0){
+      wfi();
+    } else {
+      timeroff();
+      wfi();
+      timerset();
+    }
+  }
+  c->idle = 0;
+  intr_on();
+}
+
+// Change p's scheduling class to cls, moving it to the
+// right queue if it is queued.
+// Caller must hold p->lock.
+void
+runqsetclass(struct proc *p, int cls)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqsetclass lock");
+
+  if((rq = p->rq) != 0){
+    acquire(&rq->lock);
+    if(p->rq == rq){
+      runqremove(rq, p);
+      p->cls = cls;
+      runqinsert(rq, p);
+      release(&rq->lock);
+      return;
+    }
+    release(&rq->lock);
+  }
+  p->cls = cls;
+}
+
+// Restrict p to the cpus in mask. If p is queued on a cpu
+// it may no longer use, queue it again elsewhere; if it is
+// running on one, it moves the next time it is queued.
+// Caller must hold p->lock.
+void
+runqsetaffinity(struct proc *p, uint64 mask)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqsetaffinity lock");
+
+  if((rq = p->rq) == 0){
+    p->affinity = mask;
+    return;
+  }
+
+  // rq->nallowed counts p under its old mask.
+  acquire(&rq->lock);
+  if(p->rq != rq){
+    p->affinity = mask;
+    release(&rq->lock);
+    return;
+  }
+  if((mask & (1UL << rq->cpu)) == 0){
+    runqremove(rq, p);
+    p->affinity = mask;
+    release(&rq->lock);
+    runqadd(p);
+    return;
+  }
+  runqcount(rq, p, -1);
+  p->affinity = mask;
+  runqcount(rq, p, 1);
+  release(&rq->lock);
+}
+
+// Remove and return the process c should run next,
+// or 0 if c's queue is empty. The process stays RUNNABLE;
+// the caller must acquire its p->lock before running it.
+struct proc*
+runqpop(struct cpu *c)
+{
+  struct runq *rq = &c->rq;
+  struct proc *p;
+
+  acquire(&rq->lock);
+  p = runqtake(rq);
+  release(&rq->lock);
+  return p;
+}
+
+// The first process in q that may run on c, or 0.
+static struct proc*
+runqfirst(struct procq *q, struct cpu *c)
+{
+  struct proc *p;
+
+  for(p = q->head; p; p = p->rqnext)
+    if(allowed(p, c))
+      return p;
+  return 0;
+}
+
+// A process in rq that may run on c: the one rq's cpu would
+// run next if possible, else the first allowed one found in
+// class order. rq->nallowed says there is one.
+// rq->lock must be held.
+static struct proc*
+runqfind(struct runq *rq, struct cpu *c)
+{
+  struct proc *p;
+  int i;
+
+  if((p = runqpeek(rq)) != 0 && allowed(p, c))
+    return p;
+  if((p = runqfirst(&rq->dl, c)) != 0 || (p = runqfirst(&rq->rt, c)) != 0)
+    return p;
+  for(i = 0; i < NQUEUE; i++)
+    if((p = runqfirst(&rq->q[i], c)) != 0)
+      return p;
+  for(i = 0; i < rq->nheap; i++)
+    if(allowed(rq->heap[i], c))
+      return rq->heap[i];
+  if((p = runqfirst(&rq->batch, c)) != 0)
+    return p;
+  return runqfirst(&rq->idle, c);
+}
+
+// Called by cpu c when its own queue is empty: take a
+// process that may run on c from the other cpu with the
+// most of them. Queue counts are read without locks, and
+// the victim's lock is only tried, never spun on, so
+// stealing can't hold up a busy cpu.
+struct proc*
+runqsteal(struct cpu *c)
+{
+  struct cpu *v, *victim;
+  struct proc *p;
+  int me = c - cpus;
+
+  victim = 0;
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v == c || !v->online || v->rq.nallowed[me] == 0)
+      continue;
+    if(victim == 0 || v->rq.nallowed[me] > victim->rq.nallowed[me])
+      victim = v;
+  }
+  if(victim == 0)
+    return 0;
+
+  if(!tryacquire(&victim->rq.lock))
+    return 0;
+  p = 0;
+  if(victim->rq.nallowed[me] > 0 && (p = runqfind(&victim->rq, c)) != 0)
+    runqremove(&victim->rq, p);
+  release(&victim->rq.lock);
+  return p;
+}
+
+// Switch every run queue to scheduling policy pol.
+// Returns the old policy, or -1 if pol is not a policy.
+// All run queue locks are held while the queued processes
+// move over, so no cpu sees a half converted queue.
+int
+setpolicy(int pol)
+{
+  struct cpu *c;
+  struct proc *p, *head, *tail;
+  int old;
+
+  if(pol < 0 || pol >= NSCHED)
+    return -1;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    acquire(&c->rq.lock);
+
+  old = policy;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    // drain in the old policy's order...
+    policy = old;
+    head = tail = 0;
+    while((p = runqtake(&c->rq)) != 0){
+      p->rqnext = 0;
+      if(tail)
+        tail->rqnext = p;
+      else
+        head = p;
+      tail = p;
+    }
+    // ...and queue again under the new one.
+    policy = pol;
+    while((p = head) != 0){
+      head = p->rqnext;
+      runqinsert(&c->rq, p);
+    }
+  }
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    release(&c->rq.lock);
+
+  return old;
+}
+
+// Name of the current policy, for procdump().
+char*
+policyname(void)
+{
+  return classes[policy]->name;
+}
@@ -0,0 +1,16 @@
+// Scheduling policies, for setsched().
+#define SCHED_RR    0  // round robin
+#define SCHED_FCFS  1  // first come first served
+#define SCHED_PBS   2  // priority based
+#define SCHED_MLFQ  3  // multilevel feedback queue
+#define SCHED_STRIDE 4 // stride proportional share, by tickets
+#define NSCHED      5
+
+// Per-process scheduling classes, for setclass().
+// A cpu always runs a queued process of a lower-numbered
+// class first.
+#define CLASS_EDF    0  // earliest deadline first, entered with setdeadline()
+#define CLASS_RT     1  // real-time FIFO, never timesliced
+#define CLASS_NORMAL 2  // scheduled by the current policy
+#define CLASS_BATCH  3  // long slices, not preempted by batch peers
+#define CLASS_IDLE   4  // runs only when nothing else can
@@ -0,0 +1,95 @@
+// Slab allocator: caches of same-sized kernel objects, for
+// pipes, files, inodes and procs, so that they need neither a
+// fixed table nor a page each.
+//
+// A cache carves pages from kalloc() into objects, and keeps the
+// free ones in a depot. Each cpu takes objects from the depot,
+// and gives them back, NMAG/2 at a time, into its own magazine,
+// and serves allocations and frees from there with interrupts
+// off and no lock. Pages stay with their cache once carved.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "slab.h"
+#include "defs.h"
+
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  size = (size + 7) & ~7;
+  if(size > PGSIZE)
+    panic("kmem_cache_init");
+  c->name = name;
+  c->size = size;
+  initlock(&c->lock, name);
+}
+
+// Fill m half way from the depot, carving a fresh page into
+// the depot first if it is empty. c->lock must be held.
+static void
+refill(struct kmem_cache *c, struct magazine *m)
+{
+  char *pg, *o;
+  void *obj;
+
+  if(c->depot == 0 && (pg = kalloc()) != 0){
+    c->npage++;
+    for(o = pg; o + c->size <= pg + PGSIZE; o += c->size){
+      *(void**)o = c->depot;
+      c->depot = o;
+      c->ndepot++;
+    }
+  }
+  while(m->n < NMAG/2 && (obj = c->depot) != 0){
+    c->depot = *(void**)obj;
+    c->ndepot--;
+    m->obj[m->n++] = obj;
+  }
+}
+
+// Allocate an object from c, with junk in it.
+// Returns 0 if out of memory.
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    refill(c, m);
+    release(&c->lock);
+  }
+  obj = m->n > 0 ? m->obj[--m->n] : 0;
+  pop_off();
+  return obj;
+}
+
+// Give obj, from kmem_cache_alloc(c), back to c.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+  void *o;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == NMAG){
+    // full: pass half of it on to the depot.
+    acquire(&c->lock);
+    while(m->n > NMAG/2){
+      o = m->obj[--m->n];
+      *(void**)o = c->depot;
+      c->depot = o;
+      c->ndepot++;
+    }
+    release(&c->lock);
+  }
+  m->obj[m->n++] = obj;
+  pop_off();
+}
@@ -0,0 +1,18 @@
+// Caches of fixed-size kernel objects, carved from whole pages.
+// Each cpu keeps a magazine of free objects, so most allocations
+// and frees take no lock at all; see slab.c.
+struct magazine {
+  int n;                 // free objects in obj[]
+  void *obj[NMAG];
+};
+
+struct kmem_cache {
+  char *name;            // for debugging
+  uint size;             // object size, rounded up to 8 bytes
+  struct magazine mag[NCPU]; // used only by its cpu, with interrupts off
+
+  struct spinlock lock;  // protects everything below here
+  void *depot;           // free objects, linked through their first word
+  int ndepot;            // objects in depot
+  int npage;             // pages carved into objects
+};
@@ -42,6 +42,26 @@ acquire(struct spinlock *lk)
   lk->cpu = mycpu();
 }
 
+// Try to acquire the lock without spinning.
+// Returns 1 if the lock is now held, 0 if some
+// other cpu holds it.
+int
+tryacquire(struct spinlock *lk)
+{
+  push_off();
+  if(holding(lk))
+    panic("tryacquire");
+
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    pop_off();
+    return 0;
+  }
+
+  __sync_synchronize();
+  lk->cpu = mycpu();
+  return 1;
+}
+
 // Release the lock.
 void
 release(struct spinlock *lk)
@@ -54,8 +54,8 @@ start()
   asm volatile("mret");
 }
 
-// set up to receive timer interrupts in machine mode,
-// which arrive at timervec in kernelvec.S,
+// set up to receive timer and software interrupts in
+// machine mode, which arrive at timervec in kernelvec.S,
 // which turns them into software interrupts for
 // devintr() in trap.c.
 void
@@ -64,17 +64,17 @@ timerinit()
   // each CPU has a separate source of timer interrupts.
   int id = r_mhartid();
 
-  // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  // ask the CLINT for the first timer interrupt; after
+  // that the kernel asks for each tick itself (timerset()).
+  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + TICKCYCLES;
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[4] : address of CLINT MSIP register.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  scratch[4] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -83,6 +83,7 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer interrupts, and software
+  // interrupts, which other harts send to wake this one.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
@@ -106,6 +106,19 @@ extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
 extern uint64 sys_strace(void);
 extern uint64 sys_setpriority(void);
+extern uint64 sys_setsched(void);
+extern uint64 sys_setclass(void);
+extern uint64 sys_setdeadline(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_waitx(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_kmemstat(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -131,6 +144,19 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_strace]   sys_strace,
 [SYS_setpriority] sys_setpriority,
+[SYS_setsched] sys_setsched,
+[SYS_setclass] sys_setclass,
+[SYS_setdeadline] sys_setdeadline,
+[SYS_getrusage] sys_getrusage,
+[SYS_waitx]   sys_waitx,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_kmemstat] sys_kmemstat,
 
 };
 
@@ -158,7 +184,7 @@ syscall(void)
   }
   
     
-  if (p->mask & (1<<num)) 
+  if (num > 0 && num < NELEM(syscalls) && (p->mask & (1UL << num)))
   {
     switch(num)
     {
@@ -228,6 +254,48 @@ syscall(void)
       case 22:
         printf("%d: syscall strace{%d} => %d\n", p->pid, firstarg,  p->trapframe->a0);
         break;
+      case 23:
+        printf("%d: syscall setpriority{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 24:
+        printf("%d: syscall setsched{%d} => %d\n", p->pid, firstarg,  p->trapframe->a0);
+        break;
+      case 25:
+        printf("%d: syscall setclass{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 26:
+        printf("%d: syscall setdeadline{%d %d %d} => %d\n", p->pid, firstarg,p->trapframe->a1,p->trapframe->a2,  p->trapframe->a0);
+        break;
+      case 27:
+        printf("%d: syscall getrusage{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 28:
+        printf("%d: syscall waitx{%d %d %d %d} => %d\n", p->pid, firstarg,p->trapframe->a1,p->trapframe->a2,p->trapframe->a3,  p->trapframe->a0);
+        break;
+      case 29:
+        printf("%d: syscall setaffinity{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 30:
+        printf("%d: syscall getaffinity{%d} => %d\n", p->pid, firstarg,  p->trapframe->a0);
+        break;
+      case 31:
+        printf("%d: syscall clone{%d %d %d} => %d\n", p->pid, firstarg,p->trapframe->a1,p->trapframe->a2,  p->trapframe->a0);
+        break;
+      case 32:
+        printf("%d: syscall join{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 33:
+        printf("%d: syscall futex_wait{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 34:
+        printf("%d: syscall futex_wake{%d %d} => %d\n", p->pid, firstarg, p->trapframe->a1 , p->trapframe->a0);
+        break;
+      case 35:
+        printf("%d: syscall nanosleep{%d} => %d\n", p->pid, firstarg,  p->trapframe->a0);
+        break;
+      case 36:
+        printf("%d: syscall kmemstat{%d} => %d\n", p->pid, firstarg,  p->trapframe->a0);
+        break;
 
 
     }
@@ -22,3 +22,16 @@
 #define SYS_close  21
 #define SYS_strace 22
 #define SYS_setpriority 23
+#define SYS_setsched 24
+#define SYS_setclass 25
+#define SYS_setdeadline 26
+#define SYS_getrusage 27
+#define SYS_waitx 28
+#define SYS_setaffinity 29
+#define SYS_getaffinity 30
+#define SYS_clone 31
+#define SYS_join 32
+#define SYS_futex_wait 33
+#define SYS_futex_wake 34
+#define SYS_nanosleep 35
+#define SYS_kmemstat 36
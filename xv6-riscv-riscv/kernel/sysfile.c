@@ -17,52 +17,33 @@
 #include "fcntl.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return the corresponding struct file, with a reference
+// the caller must drop with fileclose(): threads share the
+// descriptor table, so another one may close fd meanwhile.
 static int
-argfd(int n, int *pfd, struct file **pf)
+argfd(int n, struct file **pf)
 {
   int fd;
-  struct file *f;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((*pf = fdget(myproc()->fdt, fd)) == 0)
     return -1;
-  if(pfd)
-    *pfd = fd;
-  if(pf)
-    *pf = f;
   return 0;
 }
 
-// Allocate a file descriptor for the given file.
-// Takes over file reference from caller on success.
-static int
-fdalloc(struct file *f)
-{
-  int fd;
-  struct proc *p = myproc();
-
-  for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
-      return fd;
-    }
-  }
-  return -1;
-}
-
 uint64
 sys_dup(void)
 {
   struct file *f;
   int fd;
 
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  if((fd=fdalloc(myproc()->fdt, f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,25 +51,29 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, &f) < 0)
     return -1;
 
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
@@ -97,9 +82,8 @@ sys_close(void)
   int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(argint(0, &fd) < 0 || (f = fdremove(myproc()->fdt, fd)) == 0)
     return -1;
-  myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
@@ -109,10 +93,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -322,7 +309,7 @@ sys_open(void)
     return -1;
   }
 
-  if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
+  if((f = filealloc()) == 0 || (fd = fdalloc(myproc()->fdt, f)) < 0){
     if(f)
       fileclose(f);
     iunlockput(ip);
@@ -467,17 +454,17 @@ sys_pipe(void)
   if(pipealloc(&rf, &wf) < 0)
     return -1;
   fd0 = -1;
-  if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
+  if((fd0 = fdalloc(p->fdt, rf)) < 0 || (fd1 = fdalloc(p->fdt, wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
+      fdremove(p->fdt, fd0);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+    fdremove(p->fdt, fd0);
+    fdremove(p->fdt, fd1);
     fileclose(rf);
     fileclose(wf);
     return -1;
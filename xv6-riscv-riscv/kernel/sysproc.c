@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "kmemstat.h"
 
 uint64
 sys_exit(void)
@@ -38,6 +39,42 @@ sys_wait(void)
   return wait(p);
 }
 
+// wait() that also reports the child's wait time,
+// run time and number of runs.
+uint64
+sys_waitx(void)
+{
+  uint64 p, wtime, rtime, nrun;
+
+  if(argaddr(0, &p) < 0 || argaddr(1, &wtime) < 0 ||
+     argaddr(2, &rtime) < 0 || argaddr(3, &nrun) < 0)
+    return -1;
+  return waitx(p, wtime, rtime, nrun);
+}
+
+// start a thread at fn(arg) on stack, sharing
+// this process's memory.
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+  uint64 stack;
+
+  if(argint(0, &tid) < 0 || argaddr(1, &stack) < 0)
+    return -1;
+  return join(tid, stack);
+}
+
 uint64
 sys_sbrk(void)
 {
@@ -56,21 +93,23 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n <= 0)
+    return 0;
+  return timerwait(*(uint64*)CLINT_MTIME + (uint64)n * TICKCYCLES);
+}
+
+// sleep for ns nanoseconds, to the resolution of mtime.
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  if(argaddr(0, &ns) < 0)
+    return -1;
+  return timerwait(*(uint64*)CLINT_MTIME + ns / (1000000000 / MTIMEHZ));
 }
 
 uint64
@@ -100,7 +139,7 @@ uint64
 sys_strace(void)
 {
   
-  if(argint(0, &myproc()->mask) < 0)
+  if(argaddr(0, &myproc()->mask) < 0)
     return -1;
   //printf("recieved mask it is nothing but %d\n",myproc()->mask);
 
@@ -136,3 +175,120 @@ sys_setpriority(void)
   return procsetpriority(pid,priority);
   
 }
+
+uint64
+sys_setclass(void)
+{
+  int cls, pid;
+
+  if(argint(0, &cls) < 0)
+    return -1;
+  if(argint(1, &pid) < 0)
+    return -1;
+  return procsetclass(pid, cls);
+}
+
+// switch the scheduling policy of every cpu.
+// returns the old policy, or -1.
+uint64
+sys_setsched(void)
+{
+  int pol;
+
+  if(argint(0, &pol) < 0)
+    return -1;
+  return setpolicy(pol);
+}
+
+// make this process an EDF process: runtime ticks
+// of cpu per period, due deadline ticks after release.
+uint64
+sys_setdeadline(void)
+{
+  int runtime, period, deadline;
+
+  if(argint(0, &runtime) < 0)
+    return -1;
+  if(argint(1, &period) < 0)
+    return -1;
+  if(argint(2, &deadline) < 0)
+    return -1;
+  return procsetdeadline(runtime, period, deadline);
+}
+
+// cpu usage of this process or its children,
+// in nanoseconds.
+uint64
+sys_getrusage(void)
+{
+  int who;
+  uint64 ru;
+
+  if(argint(0, &who) < 0)
+    return -1;
+  if(argaddr(1, &ru) < 0)
+    return -1;
+  return procrusage(who, ru);
+}
+
+// pin process pid to the cpus in mask.
+uint64
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argint(1, &mask) < 0)
+    return -1;
+  return procsetaffinity(pid, (uint)mask);
+}
+
+uint64
+sys_getaffinity(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return procgetaffinity(pid);
+}
+
+// sleep while the int at addr holds val.
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait(addr, val);
+}
+
+// wake up to n threads sleeping on the int at addr.
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake(addr, n);
+}
+
+// copy out the free block counts of the page allocator.
+uint64
+sys_kmemstat(void)
+{
+  uint64 addr;
+  struct kmemstat st;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  kmemstat(&st);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
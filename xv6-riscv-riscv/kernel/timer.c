@@ -0,0 +1,130 @@
+// Sleep timers, for sleep() and nanosleep().
+//
+// A process sleeping for a while goes on a binary min-heap
+// ordered by the mtime at which its sleep ends. cpu0, which
+// keeps ticks, arms its timer for the next tick or the first
+// wakeup, whichever is sooner, and wakes each sleeper once,
+// when its time comes, instead of every sleeper every tick.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct proc *heap[NPROC];
+  int n;
+  uint64 armed;     // mtime cpu0's timer is set for
+} timers;
+
+void
+timersinit(void)
+{
+  initlock(&timers.lock, "timers");
+  timers.armed = ~0UL;
+}
+
+static void
+timerswap(int i, int j)
+{
+  struct proc *t;
+
+  t = timers.heap[i];
+  timers.heap[i] = timers.heap[j];
+  timers.heap[j] = t;
+  timers.heap[i]->timeridx = i;
+  timers.heap[j]->timeridx = j;
+}
+
+// Restore heap order around slot i after it changed.
+static void
+timerfix(int i)
+{
+  int c;
+
+  while(i > 0 && timers.heap[i]->wakeat < timers.heap[(i-1)/2]->wakeat){
+    timerswap(i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    c = 2*i + 1;
+    if(c >= timers.n)
+      break;
+    if(c+1 < timers.n && timers.heap[c+1]->wakeat < timers.heap[c]->wakeat)
+      c++;
+    if(timers.heap[c]->wakeat >= timers.heap[i]->wakeat)
+      break;
+    timerswap(i, c);
+    i = c;
+  }
+}
+
+static void
+timerdelete(struct proc *p)
+{
+  int i = p->timeridx;
+
+  p->timeridx = -1;
+  timers.n--;
+  if(i != timers.n){
+    timers.heap[i] = timers.heap[timers.n];
+    timers.heap[i]->timeridx = i;
+    timerfix(i);
+  }
+}
+
+// Set cpu0's timer for t. Any hart may do this: the CLINT
+// registers are all mapped, and if it races with timervec
+// turning the timer off, cpu0's timerexpire() re-arms it.
+static void
+timerarm(uint64 t)
+{
+  timers.armed = t;
+  *(uint64*)CLINT_MTIMECMP(0) = t;
+}
+
+// Sleep until mtime reaches until.
+// Returns 0, or -1 if killed.
+int
+timerwait(uint64 until)
+{
+  struct proc *p = myproc();
+
+  acquire(&timers.lock);
+  p->wakeat = until;
+  p->timeridx = timers.n;
+  timers.heap[timers.n++] = p;
+  timerfix(p->timeridx);
+  if(until < timers.armed)
+    timerarm(until);
+  while(*(uint64*)CLINT_MTIME < until && !p->killed)
+    sleep(&p->wakeat, &timers.lock);
+  if(p->timeridx >= 0)
+    timerdelete(p);
+  release(&timers.lock);
+  return p->killed ? -1 : 0;
+}
+
+// Called on cpu0 by clockintr() with the current mtime and
+// that of the next tick: wake the sleepers whose time has
+// come, and arm the timer for whatever is next.
+void
+timerexpire(uint64 now, uint64 nexttick)
+{
+  struct proc *p;
+
+  acquire(&timers.lock);
+  while(timers.n > 0 && (p = timers.heap[0])->wakeat <= now){
+    timerdelete(p);
+    wakeproc(p, &p->wakeat);
+  }
+  if(timers.n > 0 && timers.heap[0]->wakeat < nexttick)
+    timerarm(timers.heap[0]->wakeat);
+  else
+    timerarm(nexttick);
+  release(&timers.lock);
+}
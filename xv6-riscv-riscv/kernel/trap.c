@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
 struct spinlock tickslock;
@@ -46,6 +47,9 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+
+  // uservec has flushed the TLB; see tlbshootdown().
+  mycpu()->userseq++;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -65,6 +69,8 @@ usertrap(void)
     intr_on();
 
     syscall();
+  } else if(r_scause() == 15 && uvmcow(p->pagetable, r_stval()) == 0){
+    // store to a copy-on-write page, now copied.
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
@@ -76,8 +82,14 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // an EDF process whose job is out of budget
+  // waits for its next period.
+  if(p->cls == CLASS_EDF)
+    edfthrottle(p);
+
+  // give up the CPU if this is a timer interrupt
+  // and the policy says p's time is up.
+  if(which_dev == 2 && runqtick(p))
     yield();
 
   usertrapret();
@@ -96,6 +108,11 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  // from here on this hart may use p's TLB entries again;
+  // userret flushes the TLB after tlbshootdown() sees this.
+  mycpu()->userseq++;
+  __sync_synchronize();
+
   // send syscalls, interrupts, and exceptions to trampoline.S
   w_stvec(TRAMPOLINE + (uservec - trampoline));
 
@@ -125,7 +142,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(p->tfva, satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -149,30 +166,61 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-
-#ifdef FCFS
-// do nothing
-#else
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  // give up the CPU if this is a timer interrupt
+  // and the policy says the process's time is up.
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING && runqtick(myproc()))
     yield();
 
-#endif
-
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
   w_sstatus(sstatus);
 }
 
+// Ask for a timer interrupt on this hart one tick from now.
+void
+timerset(void)
+{
+  *(uint64*)CLINT_MTIMECMP(cpuid()) = *(uint64*)CLINT_MTIME + TICKCYCLES;
+}
+
+// Turn this hart's timer off.
 void
+timeroff(void)
+{
+  *(uint64*)CLINT_MTIMECMP(cpuid()) = ~0UL;
+}
+
+// Interrupt cpu c, to wake it from wfi.
+void
+cpukick(struct cpu *c)
+{
+  *(uint32*)CLINT_MSIP(c - cpus) = 1;
+}
+
+// mtime of the next tick. Only cpu0 keeps ticks.
+static uint64 nexttick;
+
+// Called on cpu0 for every timer interrupt or kick: count a
+// tick if one is due, then wake the timed sleepers whose time
+// has come and re-arm the timer. Returns 1 if a tick passed.
+int
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  updatetime();
-  wakeup(&ticks);
-  release(&tickslock);
+  uint64 now = *(uint64*)CLINT_MTIME;
+  int tick = 0;
+
+  if(now >= nexttick){
+    acquire(&tickslock);
+    ticks++;
+    release(&tickslock);
+    nexttick += TICKCYCLES;
+    if(nexttick <= now)
+      nexttick = now + TICKCYCLES;
+    tick = 1;
+  }
+  timerexpire(now, nexttick);
+  return tick;
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -208,17 +256,27 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt, forwarded by timervec in kernelvec.S
+    // from a machine-mode timer interrupt or from a kick by
+    // another hart.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // cpu0's timer also wakes timed sleepers between ticks,
+    // so it goes by the clock rather than by what fired.
+    if(cpuid() == 0)
+      return clockintr() ? 2 : 1;
+
+    // timervec turns the timer off when it fires, so a
+    // timer that is still on means a kick.
+    if(*(uint64*)CLINT_MTIMECMP(cpuid()) != ~0UL)
+      return 1;
+
+    // a hart only takes ticks while it asks for them.
+    timerset();
+
     return 2;
   } else {
     return 0;
@@ -30,6 +30,10 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, so harts can program their own timers
+  // and wake each other.
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -43,8 +47,7 @@ kvmmake(void)
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // map kernel stacks
-  proc_mapstacks(kpgtbl);
+  // kernel stacks are mapped by allocproc(), as needed.
   
   return kpgtbl;
 }
@@ -88,9 +91,8 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -160,7 +162,8 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 }
 
 // Remove npages of mappings starting from va. va must be
-// page-aligned. The mappings must exist.
+// page-aligned. The mappings must exist, though uvmrevoke()
+// may have cleared their PTE_V.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
@@ -174,7 +177,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0)
       panic("uvmunmap: walk");
-    if((*pte & PTE_V) == 0)
+    if(*pte == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
@@ -192,10 +195,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -209,8 +211,7 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
   memmove(mem, src, sz);
 }
@@ -228,12 +229,11 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -261,6 +261,21 @@ uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
   return newsz;
 }
 
+// Clear PTE_V in the mappings uvmdealloc() would remove to
+// go from oldsz to newsz, but keep the rest of each PTE, so
+// uvmdealloc() can still free the pages once no TLB holds
+// them.
+void
+uvmrevoke(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  uint64 a;
+  pte_t *pte;
+
+  for(a = PGROUNDUP(newsz); a < PGROUNDUP(oldsz); a += PGSIZE)
+    if((pte = walk(pagetable, a, 0)) != 0)
+      *pte &= ~PTE_V;
+}
+
 // Recursively free page-table pages.
 // All leaf mappings must already have been removed.
 void
@@ -293,12 +308,14 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 
 // Given a parent process's page table, copy
 // its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// With cow, share the physical pages instead, making the
+// writable ones read-only and PTE_COW in both page tables,
+// so that uvmcow() copies each only when it is written.
+// Otherwise copy the physical memory too.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
-uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+uvmcopy(pagetable_t old, pagetable_t new, uint64 sz, int cow)
 {
   pte_t *pte;
   uint64 pa, i;
@@ -311,7 +328,20 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
     if((*pte & PTE_V) == 0)
       panic("uvmcopy: page not present");
     pa = PTE2PA(*pte);
+    if(cow){
+      if(*pte & PTE_W)
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      flags = PTE_FLAGS(*pte);
+      kdup((void*)pa);
+      if(mappages(new, i, PGSIZE, pa, flags) != 0){
+        kfree((void*)pa);
+        goto err;
+      }
+      continue;
+    }
     flags = PTE_FLAGS(*pte);
+    if(flags & PTE_COW)
+      flags = (flags | PTE_W) & ~PTE_COW;
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -327,6 +357,81 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return -1;
 }
 
+// Handle a write to the copy-on-write page at va: give the
+// page table a copy of its own, or, if it is the last one
+// mapping the page, just make the page writable again.
+// Returns 0, or -1 if va is not a copy-on-write page or
+// there is no memory for the copy.
+// No lock is needed: threads never share a page table with
+// COW pages in it (see uvmprivate()), and a count of one
+// means no other page table maps the page, so nobody can
+// take a new reference meanwhile.
+int
+uvmcow(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 ||
+     (*pte & PTE_COW) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefs((void*)pa) > 1){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | flags;
+    kfree((void*)pa);
+  } else {
+    *pte = PA2PTE(pa) | flags;
+  }
+  return 0;
+}
+
+// If the user page at va is copy-on-write, copy it now, since
+// the kernel is about to write it through its physical address,
+// or name it by that address. Returns 0, or -1 if that fails.
+int
+uvmunshare(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    return -1;
+  pte = walk(pagetable, va, 0);
+  if(pte && (*pte & PTE_V) && (*pte & PTE_COW))
+    return uvmcow(pagetable, va);
+  return 0;
+}
+
+// Give the page table its own copy of every copy-on-write
+// page below sz, before clone() lets threads share it:
+// uvmcow() changes a PTE without flushing other harts' TLBs,
+// so a page table that threads share must map no COW pages.
+// Returns 0, or -1 if out of memory.
+int
+uvmprivate(pagetable_t pagetable, uint64 sz)
+{
+  uint64 va;
+  pte_t *pte;
+
+  for(va = 0; va < sz; va += PGSIZE){
+    pte = walk(pagetable, va, 0);
+    if(pte && (*pte & PTE_V) && (*pte & PTE_U) && (*pte & PTE_COW) &&
+       uvmcow(pagetable, va) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
 void
@@ -350,6 +455,8 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
+    if(uvmunshare(pagetable, va0) < 0)
+      return -1;
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
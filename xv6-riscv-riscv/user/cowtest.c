@@ -0,0 +1,123 @@
+// Copy-on-write fork test and benchmark.
+// Checks that parent and child see their own writes only,
+// including writes the kernel makes with read(), then times
+// fork+exit+wait from a parent with a large heap and shows
+// how little free memory each child takes.
+//
+//   cowtest [heap MB] [forks]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/kmemstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+int
+freepages(void)
+{
+  struct kmemstat st;
+  uint64 n;
+  int k;
+
+  if(kmemstat(&st) < 0)
+    return -1;
+  n = st.cached + st.zeroed;
+  for(k = 0; k < NORDER; k++)
+    n += st.nfree[k] << k;
+  return n;
+}
+
+void
+fail(char *why)
+{
+  printf("cowtest: %s\n", why);
+  exit(1);
+}
+
+// parent and child each write the shared pages, and each
+// must see only its own values.
+void
+isolation(char *mem, int npage)
+{
+  int i, pid, status, fds[2];
+
+  for(i = 0; i < npage; i++)
+    mem[i * PGSIZE] = 'p';
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0){
+    for(i = 0; i < npage; i++)
+      if(mem[i * PGSIZE] != 'p')
+        fail("child did not see parent's data");
+    for(i = 0; i < npage; i += 2)
+      mem[i * PGSIZE] = 'c';
+    // let the kernel write a shared page too.
+    if(read(fds[0], mem + PGSIZE, 1) != 1 || mem[PGSIZE] != 'k')
+      fail("read into shared page failed");
+    for(i = 0; i < npage; i += 2)
+      if(mem[i * PGSIZE] != 'c')
+        fail("child lost its own write");
+    exit(0);
+  }
+  for(i = 1; i < npage; i += 2)
+    mem[i * PGSIZE] = 'q';
+  write(fds[1], "k", 1);
+  wait(&status);
+  if(status != 0)
+    exit(1);
+  for(i = 0; i < npage; i++)
+    if(mem[i * PGSIZE] != (i % 2 ? 'q' : 'p'))
+      fail("parent saw child's write");
+  close(fds[0]);
+  close(fds[1]);
+  printf("isolation: ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, nfork, npage, i, pid, start, span, before, failed, status;
+  char *mem;
+
+  mb = 16;
+  nfork = 100;
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(argc > 2)
+    nfork = atoi(argv[2]);
+  if(mb < 1 || nfork < 1){
+    printf("usage: cowtest [heap MB] [forks]\n");
+    exit(1);
+  }
+
+  npage = mb * 256;
+  if((mem = sbrk(npage * PGSIZE)) == (char*)-1)
+    fail("sbrk failed");
+  isolation(mem, npage);
+
+  // the child reports free memory while it is still alive.
+  before = freepages();
+  failed = 0;
+  start = uptime();
+  for(i = 0; i < nfork; i++){
+    pid = fork();
+    if(pid < 0)
+      fail("fork failed");
+    if(pid == 0)
+      exit(freepages() < before - npage / 2);
+    wait(&status);
+    if(status != 0)
+      failed = 1;
+  }
+  span = uptime() - start;
+  printf("%d forks of a %d MB process: %d ticks\n", nfork, mb, span);
+  if(failed)
+    fail("a child copied its parent's memory");
+  printf("each child took under half its parent's pages: ok\n");
+  exit(0);
+}
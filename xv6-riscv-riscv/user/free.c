@@ -0,0 +1,35 @@
+// Print free physical memory: the buddy pool's free blocks
+// of each order, the pages on the per-cpu lists, the pages
+// zeroed ahead, and the total.
+//
+//   free
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/kmemstat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct kmemstat st;
+  uint64 pages;
+  int k;
+
+  if(kmemstat(&st) < 0){
+    printf("free: kmemstat failed\n");
+    exit(1);
+  }
+  printf("order\tpages\tfree blocks\n");
+  pages = st.cached;
+  for(k = 0; k < NORDER; k++){
+    printf("%d\t%d\t%d\n", k, 1 << k, (int)st.nfree[k]);
+    pages += st.nfree[k] << k;
+  }
+  pages += st.zeroed;
+  printf("cpu lists: %d pages\n", (int)st.cached);
+  printf("zeroed: %d pages\n", (int)st.zeroed);
+  printf("total: %d pages, %d KB\n", (int)pages, (int)(pages * 4));
+  exit(0);
+}
@@ -0,0 +1,80 @@
+// Page allocator stress test.
+// Forks nproc children that each grow and shrink their heap
+// by NPAGE pages, rounds times, so that every hart hammers
+// kalloc() and kfree() at once. Reports pages allocated per
+// tick across all of them. Run it with make qemu CPUS=1 and
+// then more, with nproc the number of cpus, to see whether
+// throughput scales.
+//
+//   kallocstress [nproc] [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NPAGE 64
+#define PGSIZE 4096
+
+void
+churn(int rounds)
+{
+  int r, i;
+  char *p;
+
+  for(r = 0; r < rounds; r++){
+    p = sbrk(NPAGE * PGSIZE);
+    if(p == (char*)-1){
+      printf("kallocstress: sbrk failed\n");
+      exit(1);
+    }
+    // check each page is really ours.
+    for(i = 0; i < NPAGE; i++)
+      p[i * PGSIZE] = r;
+    for(i = 0; i < NPAGE; i++){
+      if(p[i * PGSIZE] != (char)r){
+        printf("kallocstress: page %d corrupted\n", i);
+        exit(1);
+      }
+    }
+    sbrk(-NPAGE * PGSIZE);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc, rounds, i, pid, start, span, status, failed;
+
+  nproc = 4;
+  rounds = 200;
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(nproc < 1 || rounds < 1){
+    printf("usage: kallocstress [nproc] [rounds]\n");
+    exit(1);
+  }
+
+  start = uptime();
+  for(i = 0; i < nproc; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("kallocstress: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      churn(rounds);
+      exit(0);
+    }
+  }
+  failed = 0;
+  while(wait(&status) >= 0)
+    failed |= status;
+  span = uptime() - start;
+  if(span == 0)
+    span = 1;
+  printf("%d procs x %d rounds x %d pages: %d ticks, %d pages/tick\n",
+         nproc, rounds, NPAGE, span, nproc * rounds * NPAGE / span);
+  exit(failed);
+}
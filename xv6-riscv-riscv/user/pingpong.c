@@ -0,0 +1,69 @@
+// Pipe ping-pong latency benchmark.
+// A parent and child bounce a byte across two pipes, so every
+// round trip is two sleep()/wakeup() pairs in piperead and
+// pipewrite. Reports the mean round-trip time over each round.
+// Run it on kernels before and after a change to sleep/wakeup
+// to compare them.
+//
+//   pingpong [trips] [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define USPERTICK 100000  // a tick is about 1/10th second in qemu
+
+int
+main(int argc, char *argv[])
+{
+  int trips, rounds, r, i, pid, start, span;
+  int ping[2], pong[2];
+  char c;
+
+  trips = 10000;
+  rounds = 3;
+  if(argc > 1)
+    trips = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(trips < 1 || rounds < 1){
+    printf("usage: pingpong [trips] [rounds]\n");
+    exit(1);
+  }
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf("pingpong: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("pingpong: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(ping[1]);
+    close(pong[0]);
+    while(read(ping[0], &c, 1) == 1)
+      write(pong[1], &c, 1);
+    exit(0);
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  c = 'x';
+  for(r = 0; r < rounds; r++){
+    start = uptime();
+    for(i = 0; i < trips; i++){
+      if(write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1){
+        printf("pingpong: pipe broke\n");
+        exit(1);
+      }
+    }
+    span = uptime() - start;
+    printf("round %d: %d trips in %d ticks, %d us/trip\n",
+           r, trips, span, span * USPERTICK / trips);
+  }
+  close(ping[1]);
+  wait(0);
+  exit(0);
+}
@@ -2,15 +2,261 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "kernel/memlayout.h"
+#include "kernel/rusage.h"
 
 
 #define NFORK 10
 #define IO 5
 
-int main() {
+#define NSTRIDE 3    // stride mode: children with 1, 2, ... NSTRIDE shares
+#define SPAN 300     // stride mode: ticks the children compete for
+
+// Stride mode: children with tickets in the ratio 1:2:3 spin
+// for SPAN ticks; check that their r_time follows the ratio.
+// The shares only hold among processes on the same cpu, so
+// the children inherit a pin to cpu 0.
+int stridetest(void) {
+  int i, j, pid, end, old, mask, sum, total, expected, bad;
+  int wtime, rtime;
+  int pids[NSTRIDE], rtimes[NSTRIDE];
+
+  if ((old = setsched(SCHED_STRIDE)) < 0) {
+    printf("schedulertest: no stride scheduler\n");
+    return 1;
+  }
+  mask = getaffinity(getpid());
+  setaffinity(getpid(), 1);
+  end = uptime() + SPAN;
+  for (i = 0; i < NSTRIDE; i++) {
+    pid = fork();
+    if (pid < 0)
+      break;
+    if (pid == 0) {
+      while (uptime() < end) {}; // CPU bound until the deadline
+      exit(0);
+    }
+    pids[i] = pid;
+    setpriority((i + 1) * NTICKETS, pid); // tickets under stride scheduling
+  }
+
+  total = 0;
+  for (j = 0; j < i; j++) {
+    pid = waitx(0, &wtime, &rtime, 0);
+    for (int k = 0; k < i; k++)
+      if (pids[k] == pid)
+        rtimes[k] = rtime;
+    total += rtime;
+  }
+  setaffinity(getpid(), mask);
+  setsched(old);
+  if (i < NSTRIDE) {
+    printf("schedulertest: fork failed\n");
+    return 1;
+  }
+
+  sum = NSTRIDE * (NSTRIDE + 1) / 2;
+  bad = 0;
+  for (i = 0; i < NSTRIDE; i++) {
+    expected = total * (i + 1) / sum;
+    printf("tickets %d: rtime %d, expected %d\n", (i + 1) * NTICKETS, rtimes[i], expected);
+    if (rtimes[i] < expected - total / 10 || rtimes[i] > expected + total / 10)
+      bad = 1;
+  }
+  printf("stride shares %s\n", bad ? "FAIL" : "OK");
+  return bad;
+}
+
+#define NLOAD 8      // edf mode: CPU-bound processes competing with the EDF task
+#define NJOB 20      // edf mode: periodic jobs to time
+#define RUNTIME 5    // edf mode: reservation, in ticks
+#define WORK 3       // edf mode: cpu ticks each job needs
+#define PERIOD 10
+
+#define TICKNS ((uint64)TICKCYCLES * (1000000000 / MTIMEHZ))
+
+// Spin until this process has had n more ticks of cpu time.
+void cpuwork(int n) {
+  struct rusage ru;
+  uint64 end;
+
+  getrusage(RUSAGE_SELF, &ru);
+  end = ru.runtime + n * TICKNS;
+  while (ru.runtime < end)
+    getrusage(RUSAGE_SELF, &ru);
+}
+
+// EDF mode: a periodic task with a (RUNTIME, PERIOD, PERIOD)
+// reservation needs WORK ticks of cpu per period while NLOAD
+// spinners share its cpu; every job must finish by its
+// deadline. Everyone is pinned to cpu 0, where a share of
+// 1/(NLOAD+1) would leave each job far too late.
+// Also checks that admission control refuses a reservation
+// that would overload the cpu.
+int edftest(void) {
+  int i, j, pid, release, late, worst, mask;
+  int pids[NLOAD];
+
+  if (setdeadline(PERIOD, PERIOD, PERIOD) == 0) {
+    setdeadline(0, 0, 0);
+    printf("edf admission FAIL: full cpu reservation admitted\n");
+    return 1;
+  }
+
+  mask = getaffinity(getpid());
+  setaffinity(getpid(), 1);
+
+  for (i = 0; i < NLOAD; i++) {
+    pid = fork();
+    if (pid < 0)
+      break;
+    if (pid == 0) {
+      for (;;) {}; // CPU bound until killed
+    }
+    pids[i] = pid;
+  }
+
+  worst = -PERIOD;
+  if (setdeadline(RUNTIME, PERIOD, PERIOD) < 0) {
+    printf("edf admission FAIL: reservation refused\n");
+    worst = PERIOD;
+  } else {
+    release = uptime() + 1;
+    for (j = 0; j < NJOB; j++, release += PERIOD) {
+      while (uptime() < release)
+        sleep(1);
+      cpuwork(WORK);
+      late = uptime() - (release + PERIOD);
+      if (late > worst)
+        worst = late;
+    }
+    setdeadline(0, 0, 0);
+  }
+
+  for (j = 0; j < i; j++)
+    kill(pids[j]);
+  for (; i > 0; i--)
+    wait(0);
+  setaffinity(getpid(), mask);
+  printf("edf worst lateness %d ticks: %s\n", worst, worst <= 0 ? "OK" : "FAIL");
+  return worst > 0;
+}
+
+// Bench mode: run the same CPU/IO mix under each policy
+// and print a summary table.
+//
+//   schedulertest bench [nfork [io [reps]]]
+//
+// nfork children per round, the first io of them IO bound,
+// reps rounds per policy. Times are in ticks; turnaround is
+// from the start of the round to the child's exit, and
+// throughput is children finished per 100 ticks.
+
+#define IOROUNDS 10  // bench mode: sleeps per IO-bound child
+#define IOSLEEP 20   // bench mode: ticks per sleep
+#define CPUWORK 10000000
+
+char *polnames[NSCHED] = {
+[SCHED_RR]     "RR",
+[SCHED_FCFS]   "FCFS",
+[SCHED_PBS]    "PBS",
+[SCHED_MLFQ]   "MLFQ",
+[SCHED_STRIDE] "STRIDE",
+};
+
+struct benchres {
+  int rtime, wtime, nrun, turnaround, makespan;
+};
+
+// One round of the mix under policy pol. Adds the children's
+// totals to r and returns 0, or -1 if a fork failed.
+int benchround(int pol, int nfork, int io, struct benchres *r) {
+  int n, k, pid, start, wtime, rtime, nrun;
+  volatile int i;
+
+  start = uptime();
+  for (n = 0; n < nfork; n++) {
+    pid = fork();
+    if (pid < 0)
+      break;
+    if (pid == 0) {
+      if (n < io) {
+        for (k = 0; k < IOROUNDS; k++) {
+          sleep(IOSLEEP);
+          for (i = 0; i < CPUWORK / 100; i++) {};
+        }
+      } else {
+        for (i = 0; i < CPUWORK; i++) {};
+      }
+      exit(0);
+    }
+    if (pol == SCHED_PBS)
+      setpriority(60 - io + n, pid); // IO bound first
+  }
+  for (k = n; k > 0; k--) {
+    if (waitx(0, &wtime, &rtime, &nrun) < 0)
+      break;
+    r->rtime += rtime;
+    r->wtime += wtime;
+    r->nrun += nrun;
+    r->turnaround += uptime() - start;
+  }
+  r->makespan += uptime() - start;
+  return n < nfork ? -1 : 0;
+}
+
+int bench(int nfork, int io, int reps) {
+  struct benchres r;
+  int pol, old, rep, total;
+
+  if ((old = setsched(SCHED_RR)) < 0) {
+    printf("schedulertest: setsched failed\n");
+    return 1;
+  }
+  printf("%d children (%d IO bound) x %d rounds\n", nfork, io, reps);
+  printf("policy\trtime\twtime\tnrun\tturnaround\tmakespan\tthroughput\n");
+  total = nfork * reps;
+  for (pol = 0; pol < NSCHED; pol++) {
+    memset(&r, 0, sizeof(r));
+    setsched(pol);
+    for (rep = 0; rep < reps; rep++) {
+      if (benchround(pol, nfork, io, &r) < 0) {
+        setsched(old);
+        printf("schedulertest: fork failed\n");
+        return 1;
+      }
+    }
+    printf("%s\t%d\t%d\t%d\t%d\t\t%d\t\t%d\n", polnames[pol],
+           r.rtime / total, r.wtime / total, r.nrun / total,
+           r.turnaround / total, r.makespan / reps,
+           r.makespan > 0 ? total * 100 / r.makespan : 0);
+  }
+  setsched(old);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
   int n, pid;
   int wtime, rtime;
   int twtime=0, trtime=0;
+
+  if (argc > 1 && strcmp(argv[1], "stride") == 0)
+    exit(stridetest());
+  if (argc > 1 && strcmp(argv[1], "edf") == 0)
+    exit(edftest());
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    int nfork = argc > 2 ? atoi(argv[2]) : NFORK;
+    int io = argc > 3 ? atoi(argv[3]) : IO;
+    int reps = argc > 4 ? atoi(argv[4]) : 1;
+    if (nfork < 1 || io < 0 || io > nfork || reps < 1) {
+      printf("usage: schedulertest [stride | edf | bench [nfork [io [reps]]]]\n");
+      exit(1);
+    }
+    exit(bench(nfork, io, reps));
+  }
+
   for (n=0; n < NFORK;n++) {
       pid = fork();
       if (pid < 0)
@@ -30,7 +276,7 @@ int main() {
       }
   }
   for(;n > 0; n--) {
-      if(waitx(0,&wtime,&rtime) >= 0) {
+      if(waitx(0,&wtime,&rtime,0) >= 0) {
           trtime += rtime;
           twtime += wtime;
       } 
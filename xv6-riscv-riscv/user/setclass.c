@@ -0,0 +1,39 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+char *names[NCLASS] = {
+[CLASS_EDF]     "edf",
+[CLASS_RT]      "rt",
+[CLASS_NORMAL]  "normal",
+[CLASS_BATCH]   "batch",
+[CLASS_IDLE]    "idle",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int cls, old;
+
+  if(argc != 3){
+    printf("usage: setclass rt|normal|batch|idle pid\n");
+    exit(1);
+  }
+
+  for(cls = 0; cls < NCLASS; cls++){
+    if(strcmp(argv[1], names[cls]) == 0)
+      break;
+  }
+  if(cls == NCLASS || cls == CLASS_EDF){
+    printf("setclass: unknown class %s\n", argv[1]);
+    exit(1);
+  }
+  if((old = setclass(cls, atoi(argv[2]))) < 0){
+    printf("setclass: no process %s\n", argv[2]);
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[cls]);
+  exit(0);
+}
@@ -0,0 +1,34 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+char *names[NSCHED] = {
+[SCHED_RR]    "rr",
+[SCHED_FCFS]  "fcfs",
+[SCHED_PBS]   "pbs",
+[SCHED_MLFQ]  "mlfq",
+[SCHED_STRIDE] "stride",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int pol, old;
+
+  if(argc != 2){
+    printf("usage: setsched rr|fcfs|pbs|mlfq|stride\n");
+    exit(1);
+  }
+
+  for(pol = 0; pol < NSCHED; pol++){
+    if(strcmp(argv[1], names[pol]) == 0)
+      break;
+  }
+  if(pol == NSCHED || (old = setsched(pol)) < 0){
+    printf("setsched: unknown policy %s\n", argv[1]);
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[pol]);
+  exit(0);
+}
@@ -0,0 +1,55 @@
+// Sleep timer test.
+// Forks sleepers with staggered sleep() lengths, checking each
+// wakes no earlier than asked, then times a run of short
+// nanosleep()s, which must come out well under a tick each:
+// rounded up to ticks, NNAP naps would take NNAP ticks.
+//
+//   sleeptest [nsleepers]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NNAP 100
+#define NAPNS 2000000  // 2ms, well under a tick
+#define MAXSPAN (NNAP / 4) // ticks the naps may take; 2 if exact
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, pid, start, span, status, fails;
+
+  n = 8;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1){
+    printf("usage: sleeptest [nsleepers]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < n; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("sleeptest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      start = uptime();
+      sleep(i + 1);
+      exit(uptime() - start < i + 1);
+    }
+  }
+  fails = 0;
+  while(wait(&status) >= 0)
+    fails += status;
+  printf("sleep: %d of %d sleepers woke early\n", fails, n);
+
+  start = uptime();
+  for(i = 0; i < NNAP; i++)
+    nanosleep(NAPNS);
+  span = uptime() - start;
+  printf("nanosleep: %d naps of %d us took %d ticks, %s\n",
+         NNAP, NAPNS / 1000, span, span <= MAXSPAN ? "ok" : "TOO SLOW");
+
+  exit(fails != 0 || span > MAXSPAN);
+}
@@ -0,0 +1,85 @@
+// Load-balancing benchmark.
+// Forks uneven trees of CPU-bound processes (tree i has 2^i
+// spinning leaves) and reports the makespan of each round in
+// ticks. Run it with make qemu CPUS=3 and CPUS=8 to compare
+// kernels.
+//
+//   stealtest [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NTREE 4
+#define WORK 20000000
+
+void
+spin(void)
+{
+  volatile int i;
+
+  for(i = 0; i < WORK; i++)
+    ;
+}
+
+void tree(int) __attribute__((noreturn));
+
+// grow a binary tree of processes, depth levels deep,
+// whose leaves spin. does not return.
+void
+tree(int depth)
+{
+  int i, pid;
+
+  if(depth == 0){
+    spin();
+    exit(0);
+  }
+  for(i = 0; i < 2; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("stealtest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      tree(depth - 1);
+  }
+  while(wait(0) >= 0)
+    ;
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds, r, i, pid, start, span, total;
+
+  rounds = 3;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1){
+    printf("usage: stealtest [rounds]\n");
+    exit(1);
+  }
+
+  total = 0;
+  for(r = 0; r < rounds; r++){
+    start = uptime();
+    for(i = 0; i < NTREE; i++){
+      pid = fork();
+      if(pid < 0){
+        printf("stealtest: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0)
+        tree(i);
+    }
+    while(wait(0) >= 0)
+      ;
+    span = uptime() - start;
+    total += span;
+    printf("round %d: makespan %d ticks\n", r, span);
+  }
+  printf("average makespan %d ticks\n", total / rounds);
+  exit(0);
+}
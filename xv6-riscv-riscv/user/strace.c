@@ -9,7 +9,10 @@ int main(int argc, char *argv[])
         printf("wrong usage\n");
         exit(0);
     }
-    int mask = atoi(argv[1]);
+    // bits past 31 trace the newer syscalls, so no atoi().
+    uint64 mask = 0;
+    for (char *s = argv[1]; '0' <= *s && *s <= '9'; s++)
+        mask = mask * 10 + *s - '0';
 
     
     int pid = fork();
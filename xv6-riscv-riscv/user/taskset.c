@@ -0,0 +1,33 @@
+// Show or set the cpus a process may run on.
+// mask has bit i set for cpu i.
+//
+//   taskset pid          print pid's mask
+//   taskset mask pid     pin pid to mask
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int mask;
+
+  if(argc == 2){
+    if((mask = getaffinity(atoi(argv[1]))) < 0){
+      printf("taskset: no process %s\n", argv[1]);
+      exit(1);
+    }
+    printf("%s: mask %x\n", argv[1], mask);
+    exit(0);
+  }
+  if(argc != 3){
+    printf("usage: taskset [mask] pid\n");
+    exit(1);
+  }
+  if(setaffinity(atoi(argv[2]), atoi(argv[1])) < 0){
+    printf("taskset: cannot pin %s to mask %s\n", argv[2], argv[1]);
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,184 @@
+// User-level threads on top of clone() and join(), and
+// locks for them: lock_t spins, while mutex_t, cond_t and
+// barrier_t block in the kernel with futex_wait().
+// malloc() and free() are not thread-safe; this library
+// serializes its own calls to them only.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define TSTACK 4096   // bytes of stack per thread
+
+static lock_t alloclock;
+
+void
+lock_init(lock_t *lk)
+{
+  lk->locked = 0;
+}
+
+void
+lock_acquire(lock_t *lk)
+{
+  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+void
+lock_release(lock_t *lk)
+{
+  __sync_synchronize();
+  __sync_lock_release(&lk->locked);
+}
+
+// every thread starts here. top is the top of its stack,
+// where thread_create() left the function and argument.
+static void
+threadstart(void *top)
+{
+  uint64 *t = top;
+
+  ((void (*)(void*))t[0])((void*)t[1]);
+  exit(0);
+}
+
+// Run fn(arg) in a new thread.
+// Returns its thread id, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  char *stack;
+  uint64 *top;
+  int tid;
+
+  lock_acquire(&alloclock);
+  stack = malloc(TSTACK);
+  lock_release(&alloclock);
+  if(stack == 0)
+    return -1;
+
+  // two words for threadstart; sp stays 16-byte aligned.
+  top = (uint64*)(stack + TSTACK) - 2;
+  top[0] = (uint64)fn;
+  top[1] = (uint64)arg;
+  if((tid = clone(threadstart, top, top)) < 0){
+    lock_acquire(&alloclock);
+    free(stack);
+    lock_release(&alloclock);
+  }
+  return tid;
+}
+
+// Wait for thread tid, or any thread if tid is 0, to finish,
+// and free its stack. Returns its thread id, or -1.
+int
+thread_join(int tid)
+{
+  void *top;
+
+  if((tid = join(tid, &top)) < 0)
+    return -1;
+  lock_acquire(&alloclock);
+  free((char*)top + 2*sizeof(uint64) - TSTACK);
+  lock_release(&alloclock);
+  return tid;
+}
+
+// Mutexes after Drepper, "Futexes Are Tricky": unlock only
+// enters the kernel when someone may be waiting.
+
+void
+mutex_init(mutex_t *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(mutex_t *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // mark it contended, and sleep until it comes free.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(mutex_t *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    m->state = 0;
+    __sync_synchronize();
+    futex_wake(&m->state, 1);
+  }
+}
+
+void
+cond_init(cond_t *c)
+{
+  c->seq = 0;
+}
+
+// Release m, wait for a signal, and take m again.
+// Like any condition variable, may wake spuriously.
+void
+cond_wait(cond_t *c, mutex_t *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(cond_t *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(cond_t *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 0x7fffffff);
+}
+
+// A barrier for n threads.
+void
+barrier_init(barrier_t *b, int n)
+{
+  mutex_init(&b->m);
+  cond_init(&b->c);
+  b->n = n;
+  b->count = 0;
+  b->gen = 0;
+}
+
+// Wait until all n threads have reached the barrier.
+void
+barrier_wait(barrier_t *b)
+{
+  int gen;
+
+  mutex_lock(&b->m);
+  gen = b->gen;
+  if(++b->count == b->n){
+    b->count = 0;
+    b->gen++;
+    cond_broadcast(&b->c);
+  } else {
+    while(gen == b->gen)
+      cond_wait(&b->c, &b->m);
+  }
+  mutex_unlock(&b->m);
+}
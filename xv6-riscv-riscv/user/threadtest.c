@@ -0,0 +1,169 @@
+// Sums a shared array with 1, 2, 4, ... threads and reports
+// the ticks each run takes. The threads write their partial
+// sums straight into the parent's memory, which separate
+// processes could only do through pipes. Run it with
+// make qemu CPUS=4 to see it scale.
+// Then checks mutexes and barriers: threads bump a shared
+// counter under a mutex in phases separated by a barrier.
+// Last checks that threads share file descriptors: a pipe
+// made by a thread works in the parent, and a descriptor
+// the thread closes is closed for the parent too.
+//
+//   threadtest [maxthreads]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N (1 << 18)   // ints to sum
+#define ROUNDS 20     // passes over the array per run
+#define MAXT 8
+#define NPHASE 4      // barrier phases
+#define NINC 1000     // counter increments per thread per phase
+
+int *a;
+int nthread;
+uint64 partial[MAXT];
+lock_t donelock;
+int done;
+mutex_t mu;
+barrier_t bar;
+int counter;
+int phasebad;
+int fds[2];
+
+void
+sum(void *arg)
+{
+  int id = (int)(uint64)arg;
+  int i, r, lo, hi;
+  uint64 s;
+
+  lo = N / nthread * id;
+  hi = id == nthread - 1 ? N : lo + N / nthread;
+  s = 0;
+  for(r = 0; r < ROUNDS; r++)
+    for(i = lo; i < hi; i++)
+      s += a[i];
+  partial[id] = s;
+
+  lock_acquire(&donelock);
+  done++;
+  lock_release(&donelock);
+}
+
+void
+count(void *arg)
+{
+  int ph, i;
+
+  for(ph = 0; ph < NPHASE; ph++){
+    for(i = 0; i < NINC; i++){
+      mutex_lock(&mu);
+      counter++;
+      mutex_unlock(&mu);
+    }
+    barrier_wait(&bar);
+    // everyone has finished this phase, and nobody
+    // can start the next one until we all pass here.
+    if(counter != (ph + 1) * NINC * nthread)
+      phasebad = 1;
+    barrier_wait(&bar);
+  }
+}
+
+void
+openpipe(void *arg)
+{
+  int fd = (int)(uint64)arg;
+
+  if(pipe(fds) < 0)
+    fds[0] = fds[1] = -1;
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, max, start, bad;
+  uint64 total, expect;
+  char c;
+
+  max = MAXT;
+  if(argc > 1)
+    max = atoi(argv[1]);
+  if(max < 1 || max > MAXT){
+    printf("usage: threadtest [maxthreads <= %d]\n", MAXT);
+    exit(1);
+  }
+
+  if((a = malloc(N * sizeof(int))) == 0){
+    printf("threadtest: out of memory\n");
+    exit(1);
+  }
+  expect = 0;
+  for(i = 0; i < N; i++){
+    a[i] = i % 1000;
+    expect += a[i];
+  }
+  expect *= ROUNDS;
+  lock_init(&donelock);
+
+  bad = 0;
+  for(nthread = 1; nthread <= max; nthread *= 2){
+    done = 0;
+    start = uptime();
+    for(i = 0; i < nthread; i++){
+      if(thread_create(sum, (void*)(uint64)i) < 0){
+        printf("threadtest: thread_create failed\n");
+        exit(1);
+      }
+    }
+    for(i = 0; i < nthread; i++){
+      if(thread_join(0) < 0){
+        printf("threadtest: thread_join failed\n");
+        exit(1);
+      }
+    }
+    total = 0;
+    for(i = 0; i < nthread; i++)
+      total += partial[i];
+    printf("%d threads: %d ticks, %s\n", nthread, uptime() - start,
+           total == expect && done == nthread ? "sum ok" : "WRONG SUM");
+    if(total != expect || done != nthread)
+      bad = 1;
+  }
+
+  nthread = max;
+  counter = 0;
+  phasebad = 0;
+  mutex_init(&mu);
+  barrier_init(&bar, nthread);
+  for(i = 0; i < nthread; i++){
+    if(thread_create(count, 0) < 0){
+      printf("threadtest: thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(i = 0; i < nthread; i++)
+    thread_join(0);
+  printf("%d threads: counter %d, %s\n", nthread, counter,
+         counter == NPHASE * NINC * nthread && !phasebad ? "sync ok" : "SYNC FAILED");
+  if(counter != NPHASE * NINC * nthread || phasebad)
+    bad = 1;
+
+  if((i = dup(0)) < 0 || thread_create(openpipe, (void*)(uint64)i) < 0){
+    printf("threadtest: thread_create failed\n");
+    exit(1);
+  }
+  thread_join(0);
+  if(fds[0] < 0 || write(fds[1], "x", 1) != 1 || read(fds[0], &c, 1) != 1 ||
+     c != 'x' || close(i) == 0){
+    printf("threadtest: FILES NOT SHARED\n");
+    bad = 1;
+  } else {
+    printf("threadtest: files shared ok\n");
+  }
+
+  exit(bad);
+}
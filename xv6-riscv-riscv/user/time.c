@@ -0,0 +1,50 @@
+// Run a command and report the CPU usage of it and
+// everything it waited for, from getrusage().
+//
+//   time command [args...]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+// print ns as microseconds.
+void
+putus(char *what, uint64 ns)
+{
+  printf("%s %l us\n", what, ns / 1000);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct rusage ru;
+  int pid;
+
+  if(argc < 2){
+    printf("usage: time command [args...]\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("time: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    printf("time: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0){
+    printf("time: getrusage failed\n");
+    exit(1);
+  }
+  putus("run  ", ru.runtime);
+  putus("wait ", ru.waittime);
+  putus("sleep", ru.sleeptime);
+  printf("switches %l\n", ru.nswitch);
+  exit(0);
+}
@@ -1,5 +1,7 @@
 struct stat;
 struct rtcdate;
+struct rusage;
+struct kmemstat;
 
 // system calls
 int fork(void);
@@ -23,8 +25,21 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int strace(int);
+int strace(uint64);
 int setpriority(int,int);
+int setsched(int);
+int setclass(int,int);
+int setdeadline(int,int,int);
+int getrusage(int, struct rusage*);
+int waitx(int*, int*, int*, int*);
+int setaffinity(int, int);
+int getaffinity(int);
+int clone(void(*)(void*), void*, void*);
+int join(int, void**);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+int nanosleep(uint64);
+int kmemstat(struct kmemstat*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -42,3 +57,33 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// thread.c
+typedef struct {
+  volatile uint locked;
+} lock_t;
+void lock_init(lock_t*);
+void lock_acquire(lock_t*);
+void lock_release(lock_t*);
+int thread_create(void(*)(void*), void*);
+int thread_join(int);
+typedef struct {
+  volatile int state;  // 0 free, 1 held, 2 held with waiters
+} mutex_t;
+typedef struct {
+  volatile int seq;    // bumped by every signal
+} cond_t;
+typedef struct {
+  mutex_t m;
+  cond_t c;
+  int n, count, gen;
+} barrier_t;
+void mutex_init(mutex_t*);
+void mutex_lock(mutex_t*);
+void mutex_unlock(mutex_t*);
+void cond_init(cond_t*);
+void cond_wait(cond_t*, mutex_t*);
+void cond_signal(cond_t*);
+void cond_broadcast(cond_t*);
+void barrier_init(barrier_t*, int);
+void barrier_wait(barrier_t*);
@@ -38,3 +38,16 @@ entry("sleep");
 entry("uptime");
 entry("strace");
 entry("setpriority");
+entry("setsched");
+entry("setclass");
+entry("setdeadline");
+entry("getrusage");
+entry("waitx");
+entry("setaffinity");
+entry("getaffinity");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("nanosleep");
+entry("kmemstat");